@@ -67,12 +67,12 @@ int Accelerometer::Enable(int handle, bool enable, bool lock_en_mutex)
 	int err;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	err = HWSensorBaseWithPollrate::Enable(handle, enable, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
@@ -83,7 +83,7 @@ int Accelerometer::Enable(int handle, bool enable, bool lock_en_mutex)
 		ST_AccCalibration_API_DeInit(CALIBRATION_PERIOD_MS);
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 #else /* CONFIG_ST_HAL_ACCEL_CALIB_ENABLED */
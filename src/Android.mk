@@ -141,14 +141,20 @@ LOCAL_SRC_FILES := \
 		utils.cpp \
 		CircularBuffer.cpp \
 		FlushBufferStack.cpp \
-		FlushRequested.cpp \
+		FlushCoalescer.cpp \
 		ChangeODRTimestampStack.cpp \
+		SensorOutputPipe.cpp \
+		SensorOutputTap.cpp \
+		RateTable.cpp \
+		HandleBitmap.cpp \
 		SensorBase.cpp \
 		HWSensorBase.cpp \
 		SWSensorBase.cpp
 
 ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
 LOCAL_SRC_FILES += RingBuffer.cpp
+LOCAL_SRC_FILES += EventRingBuffer.cpp
+LOCAL_SRC_FILES += DirectChannelPlanner.cpp
 endif # CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
 
 ifdef CONFIG_ST_HAL_ACCEL_ENABLED
@@ -11,79 +11,86 @@
 
 ChangeODRTimestampStack::ChangeODRTimestampStack()
 {
-	pthread_mutex_init(&data_mutex, NULL);
-
-	elements_available = 0;
+	cache_changes = 0;
+	cache_timestamp = INT64_MAX;
+	cache_valid = false;
 }
 
 ChangeODRTimestampStack::~ChangeODRTimestampStack()
 {
-
 }
 
 int ChangeODRTimestampStack::writeElement(int64_t timestamp, int64_t newpollrate)
 {
-	pthread_mutex_lock(&data_mutex);
+	odr_change_t element;
 
-	if (elements_available >= ST_ODR_STACK_MAX_ELEMENTS) {
-		pthread_mutex_unlock(&data_mutex);
-		return -ENOMEM;
-	}
+	element.timestamp = timestamp;
+	element.pollrate = newpollrate;
 
-	timestamps[elements_available] = timestamp;
-	new_pollrate[elements_available] = newpollrate;
-	elements_available++;
-
-	pthread_mutex_unlock(&data_mutex);
+	if (!queue.push(element))
+		return -ENOMEM;
 
 	return 0;
 }
 
+/**
+ * readLastElement() - Read oldest odr change not yet applied
+ * @newpollrate: new pollrate of the stream.
+ *
+ * No lock is taken, it is called for every sample by the data thread.
+ *
+ * Return value: timestamp of odr change, -EIO if none.
+ **/
 int64_t ChangeODRTimestampStack::readLastElement(int64_t *newpollrate)
 {
-	int64_t latest_change_odr_timestamp;
+	odr_change_t element;
 
-	pthread_mutex_lock(&data_mutex);
-
-	if (elements_available == 0) {
-		pthread_mutex_unlock(&data_mutex);
+	if (!queue.peek(&element))
 		return (int64_t)(int)(-EIO);
-	}
-
-	latest_change_odr_timestamp = timestamps[0];
-	*newpollrate = new_pollrate[0];
 
-	pthread_mutex_unlock(&data_mutex);
+	*newpollrate = element.pollrate;
 
-	return latest_change_odr_timestamp;
+	return element.timestamp;
 }
 
-void ChangeODRTimestampStack::removeLastElement()
+/**
+ * nextTimestamp() - Timestamp of oldest odr change not yet processed
+ *
+ * Called for every sample by the data thread: the element peeked is
+ * cached until the queue changes, so a sample with nothing pending costs
+ * one atomic load and one compare. The result can be stale only if a
+ * reset races with the call, caller must check the element it reads.
+ *
+ * Return value: timestamp of oldest odr change, INT64_MAX if none.
+ **/
+int64_t ChangeODRTimestampStack::nextTimestamp()
 {
-	int i;
+	odr_change_t element;
+	uint64_t changes = queue.getChanges();
 
-	pthread_mutex_lock(&data_mutex);
+	if (cache_valid && (changes == cache_changes))
+		return cache_timestamp;
 
-	if (elements_available == 0) {
-		pthread_mutex_unlock(&data_mutex);
-		return;
-	}
+	cache_changes = changes;
+	cache_valid = true;
 
-	for (i = 0; i < (int)elements_available - 1; i++) {
-		timestamps[i] = timestamps[i + 1];
-		new_pollrate[i] = new_pollrate[i + 1];
-	}
+	if (queue.peek(&element))
+		cache_timestamp = element.timestamp;
+	else
+		cache_timestamp = INT64_MAX;
 
-	elements_available--;
-
-	pthread_mutex_unlock(&data_mutex);
+	return cache_timestamp;
 }
 
-void ChangeODRTimestampStack::resetBuffer()
+void ChangeODRTimestampStack::removeLastElement()
 {
-	pthread_mutex_lock(&data_mutex);
+	odr_change_t element;
 
-	elements_available = 0;
+	queue.pop(&element);
+	cache_valid = false;
+}
 
-	pthread_mutex_unlock(&data_mutex);
+void ChangeODRTimestampStack::resetBuffer()
+{
+	queue.reset();
 }
@@ -25,18 +25,28 @@
 #include <pthread.h>
 #include <errno.h>
 
-#define ST_ODR_STACK_MAX_ELEMENTS		(20)
+#include "LockFreeQueue.h"
+
+#define ST_ODR_STACK_MAX_ELEMENTS		(32)
+
+typedef struct odr_change {
+	int64_t timestamp;
+	int64_t pollrate;
+} odr_change_t;
 
 /*
  * class ChangeODRTimestampStack
+ *
+ * Written by the thread changing the ODR, read only by the data thread.
  */
 class ChangeODRTimestampStack {
 private:
-	pthread_mutex_t data_mutex;
-	unsigned int elements_available;
+	LockFreeQueue<odr_change_t, ST_ODR_STACK_MAX_ELEMENTS> queue;
 
-	int64_t new_pollrate[ST_ODR_STACK_MAX_ELEMENTS];
-	int64_t timestamps[ST_ODR_STACK_MAX_ELEMENTS];
+	/* data thread only */
+	uint64_t cache_changes;
+	int64_t cache_timestamp;
+	bool cache_valid;
 
 public:
 	ChangeODRTimestampStack();
@@ -44,6 +54,7 @@ public:
 
 	int writeElement(int64_t timestamp, int64_t newpollrate);
 	int64_t readLastElement(int64_t *newpollrate);
+	int64_t nextTimestamp();
 	void removeLastElement(void);
 	void resetBuffer();
 };
@@ -0,0 +1,85 @@
+/*
+ * STMicroelectronics Direct Channel Planner Class
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include "DirectChannelPlanner.h"
+
+/**
+ * decimation() - Integer decimation of a stream for a channel
+ * @period: nominal period of the channel rate level.
+ * @stream_period: period of the stream feeding the channel.
+ *
+ * Nearest integer ratio, kept inside the android tolerance band.
+ *
+ * Return value: decimation factor (>= 1).
+ **/
+unsigned int DirectChannelPlanner::decimation(int64_t period, int64_t stream_period)
+{
+	int64_t n;
+
+	if ((stream_period <= 0) || (period <= stream_period))
+		return 1;
+
+	n = (period + (stream_period / 2)) / stream_period;
+
+	while ((n > 1) && ((stream_period * n) > (int64_t)(period / ST_DIRECT_RATE_MIN_RATIO)))
+		n--;
+
+	while ((stream_period * n) < (int64_t)(period / ST_DIRECT_RATE_MAX_RATIO))
+		n++;
+
+	return (unsigned int)n;
+}
+
+/**
+ * planPeriod() - Pick the odr feeding a direct channel
+ * @period: nominal period of the channel rate level.
+ * @freq: available odr [Hz] in increasing order.
+ * @length: number of available odr.
+ *
+ * Among the available odr inside the android tolerance band, the one
+ * nearest (as ratio) to the nominal rate is used. If none fits the band
+ * the first odr faster than nominal one is used (as SetDelay does).
+ *
+ * Return value: period of the selected odr.
+ **/
+int64_t DirectChannelPlanner::planPeriod(int64_t period, const float *freq,
+					 unsigned int length)
+{
+	int i, best = -1;
+	float nominal, ratio, best_ratio = 0;
+
+	if ((period <= 0) || (length == 0))
+		return period;
+
+	nominal = 1E9 / (float)period;
+
+	for (i = 0; i < (int)length; i++) {
+		ratio = freq[i] / nominal;
+		if ((ratio < ST_DIRECT_RATE_MIN_RATIO) ||
+		    (ratio > ST_DIRECT_RATE_MAX_RATIO))
+			continue;
+
+		if (ratio < 1.0f)
+			ratio = 1.0f / ratio;
+
+		if ((best < 0) || (ratio < best_ratio)) {
+			best = i;
+			best_ratio = ratio;
+		}
+	}
+
+	if (best < 0) {
+		for (best = 0; best < (int)length - 1; best++) {
+			if (freq[best] >= nominal)
+				break;
+		}
+	}
+
+	return 1E9 / freq[best];
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2015-2016 STMicroelectronics
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ST_DIRECT_CHANNEL_PLANNER_H
+#define ST_DIRECT_CHANNEL_PLANNER_H
+
+#include <stdint.h>
+
+/* android tolerance band of direct report rate levels */
+#define ST_DIRECT_RATE_MIN_RATIO		(0.55f)
+#define ST_DIRECT_RATE_MAX_RATIO		(2.2f)
+
+/*
+ * class DirectChannelPlanner
+ *
+ * Stream period and integer decimation used to feed direct channels.
+ * Android requires the effective rate of a channel to stay between
+ * 0.55x and 2.2x its nominal rate level.
+ */
+class DirectChannelPlanner {
+public:
+	static unsigned int decimation(int64_t period, int64_t stream_period);
+	static int64_t planPeriod(int64_t period, const float *freq,
+				  unsigned int length);
+};
+
+#endif /* ST_DIRECT_CHANNEL_PLANNER_H */
@@ -13,17 +13,13 @@ int DynamicSensorProxy::submitEvent(__attribute__((unused)) sp<BaseSensorObject>
 				    const sensors_event_t &e)
 {
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
-		ALOGE("WriteDataToPipe: mDirectChannel is %s", mDirectChannel != nullptr ? "OK" : "NULL");
-
-		if (mDirectChannel != nullptr) {
-			if (mDirectChannelLock.tryLock() == android::NO_ERROR) {
-				mDirectChannel->write(&e);
-				mDirectChannelLock.unlock();
-			}
+		if (HasDirectChannel()) {
+			WriteDirectChannelEvent(&e, 0);
+			FlushDirectChannelBatch();
 		}
 #endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 
-	return write(write_pipe_fd, &e, sizeof(sensors_event_t));
+	return output_pipe.writeEvents(&e, 1);
 }
 
 DynamicSensorProxy::DynamicSensorProxy(STSensorHAL_data *hal_data, int index,
@@ -43,6 +39,7 @@ DynamicSensorProxy::DynamicSensorProxy(STSensorHAL_data *hal_data, int index,
 	GetSensor_tData(&hal_data->sensor_t_list[index]);
 	hal_data->android_pollfd[index].fd = GetFdPipeToRead();
 	hal_data->android_pollfd[index].events = POLLIN;
+	hal_data->android_pollfd_sensor[index] = this;
 }
 
 int DynamicSensorProxy::Enable(int handle, bool enable, __attribute__((unused)) bool lock_en_mutex)
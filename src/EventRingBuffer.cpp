@@ -0,0 +1,126 @@
+/*
+ * STMicroelectronics Event Ring Buffer for Direct Report Channel
+ *
+ * Copyright 2017 STMicroelectronics Inc.
+ * Author:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#include "EventRingBuffer.h"
+
+/* Smaller batches are copied event by event. */
+#define RING_BUFFER_SPAN_MIN_EVENTS	(16)
+
+/* Counter lies between sensor/type and timestamp fields. */
+#define RING_BUFFER_COUNTER_OFFSET	offsetof(sensors_event_t, reserved0)
+#define RING_BUFFER_DATA_OFFSET		offsetof(sensors_event_t, timestamp)
+
+RingBuffer::RingBuffer(void* buf, size_t size) : mData((sensors_event_t *)buf),
+                mSize(size/sizeof(sensors_event_t)), mWritePos(0), mCounter(1)
+{
+    memset(mData, 0, size);
+}
+
+RingBuffer::~RingBuffer()
+{
+    memset(mData, 0, mSize*sizeof(sensors_event_t));
+}
+
+int32_t RingBuffer::nextCounter()
+{
+    int32_t counter = mCounter++;
+
+    /* Counter 0 marks an invalid (not yet written) slot. */
+    if (mCounter == 0)
+        mCounter = 1;
+
+    return counter;
+}
+
+/*
+ * Copy a single event: the counter is skipped by the copy and stamped
+ * (release) after it, no need to invalidate it first.
+ */
+inline void RingBuffer::writeEvent(const sensors_event_t *ev)
+{
+    sensors_event_t *dst = &mData[mWritePos];
+
+    memcpy(dst, ev, RING_BUFFER_COUNTER_OFFSET);
+    memcpy((char *)dst + RING_BUFFER_DATA_OFFSET,
+           (const char *)ev + RING_BUFFER_DATA_OFFSET,
+           sizeof(sensors_event_t) - RING_BUFFER_DATA_OFFSET);
+
+    __atomic_store_n(&dst->reserved0, nextCounter(), __ATOMIC_RELEASE);
+
+    if (++mWritePos >= mSize)
+        mWritePos = 0;
+}
+
+/*
+ * Copy a contiguous span of events. Readers consider a slot valid only
+ * when its counter is the expected one, so the counters of the span are
+ * invalidated before the copy and stamped (release) only after it.
+ */
+void RingBuffer::writeSpan(const sensors_event_t *ev, size_t size)
+{
+    size_t i;
+    sensors_event_t *dst = &mData[mWritePos];
+
+    for (i = 0; i < size; i++)
+        __atomic_store_n(&dst[i].reserved0, 0, __ATOMIC_RELAXED);
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(dst, ev, size * sizeof(sensors_event_t));
+
+    for (i = 0; i < size; i++)
+        __atomic_store_n(&dst[i].reserved0, nextCounter(), __ATOMIC_RELEASE);
+
+    mWritePos += size;
+    if (mWritePos >= mSize)
+        mWritePos = 0;
+}
+
+void RingBuffer::writeSpans(const sensors_event_t *ev, size_t size)
+{
+    size_t span, skip;
+
+    /* Only the newest mSize events survive, skip the overridden ones. */
+    if (size > mSize) {
+        skip = size - mSize;
+        ev += skip;
+        size = mSize;
+        mWritePos = (mWritePos + skip) % mSize;
+        while (skip--)
+            nextCounter();
+    }
+
+    /* At most two spans: up to the end of the buffer and from the start. */
+    span = mSize - mWritePos;
+    if (span > size)
+        span = size;
+
+    writeSpan(ev, span);
+    if (size > span)
+        writeSpan(ev + span, size - span);
+}
+
+void RingBuffer::write(const sensors_event_t *ev, size_t size)
+{
+    if (!mSize)
+        return;
+
+    /* Span setup (invalidate, fence) pays off only on large batches. */
+    if (size >= RING_BUFFER_SPAN_MIN_EVENTS) {
+        writeSpans(ev, size);
+        return;
+    }
+
+    while (size--)
+        writeEvent(ev++);
+}
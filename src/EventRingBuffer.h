@@ -0,0 +1,42 @@
+/*
+ * STMicroelectronics Event Ring Buffer for Direct Report Channel
+ *
+ * Copyright 2017 STMicroelectronics Inc.
+ * Author:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#ifndef S_EVENT_RING_BUFFER_H_
+#define S_EVENT_RING_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hardware/sensors.h>
+
+/*
+ * Events ring of a direct report channel shared memory. Independent from
+ * the memory type (ashmem or gralloc) so it can be built on host.
+ */
+struct RingBuffer {
+	RingBuffer(void* buf, size_t size);
+	~RingBuffer();
+
+	void write(const sensors_event_t *ev, size_t size);
+
+private:
+	int32_t nextCounter();
+	void writeEvent(const sensors_event_t *ev);
+	void writeSpan(const sensors_event_t *ev, size_t size);
+	void writeSpans(const sensors_event_t *ev, size_t size);
+
+	sensors_event_t *mData;
+	size_t mSize;
+	size_t mWritePos;
+	int32_t mCounter;
+
+	RingBuffer(const RingBuffer &) = delete;
+	RingBuffer &operator=(const RingBuffer &) = delete;
+};
+
+#endif  // S_EVENT_RING_BUFFER_H_
@@ -11,90 +11,89 @@
 
 FlushBufferStack::FlushBufferStack()
 {
-	pthread_mutex_init(&data_mutex, NULL);
-
-	elements_available = 0;
+	cache_changes = 0;
+	cache_timestamp = INT64_MAX;
+	cache_valid = false;
 }
 
 FlushBufferStack::~FlushBufferStack()
 {
-
 }
 
 int FlushBufferStack::writeElement(int handle, int64_t timestamp)
 {
-	pthread_mutex_lock(&data_mutex);
+	flush_pending_t element;
 
-	if (elements_available >= ST_FLUSH_BUFFER_STACK_MAX_ELEMENTS) {
-		pthread_mutex_unlock(&data_mutex);
-		return -ENOMEM;
-	}
+	element.timestamp = timestamp;
+	element.handle = handle;
 
-	flush_timestamps[elements_available] = timestamp;
-	flush_handles[elements_available] = handle;
-	elements_available++;
-
-	pthread_mutex_unlock(&data_mutex);
+	if (!queue.push(element))
+		return -ENOMEM;
 
 	return 0;
 }
 
+/**
+ * readLastElement() - Read oldest flush not yet completed
+ * @timestamp: timestamp of flush.
+ *
+ * No lock is taken, it is called for every sample by the data thread.
+ *
+ * Return value: handle of flush, -EIO if none.
+ **/
 int FlushBufferStack::readLastElement(int64_t *timestamp)
 {
-	int flush_handle;
-
-	pthread_mutex_lock(&data_mutex);
+	flush_pending_t element;
 
-	if (elements_available == 0) {
-		pthread_mutex_unlock(&data_mutex);
+	if (!queue.peek(&element))
 		return -EIO;
-	}
 
-	*timestamp = flush_timestamps[0];
-	flush_handle = flush_handles[0];
+	*timestamp = element.timestamp;
 
-	pthread_mutex_unlock(&data_mutex);
-
-	return flush_handle;
+	return element.handle;
 }
 
 unsigned int FlushBufferStack::ElemetsOnStack()
 {
-	unsigned int data_available;
-
-	pthread_mutex_lock(&data_mutex);
-	data_available = elements_available;
-	pthread_mutex_unlock(&data_mutex);
-
-	return data_available;
+	return queue.size();
 }
 
-void FlushBufferStack::removeLastElement()
+/**
+ * nextTimestamp() - Timestamp of oldest flush not yet completed
+ *
+ * Same caching as the odr change stack: peek is repeated only after a
+ * write, a remove or a reset.
+ *
+ * Return value: timestamp of oldest flush, INT64_MAX if none.
+ **/
+int64_t FlushBufferStack::nextTimestamp()
 {
-	unsigned int i;
-
-	pthread_mutex_lock(&data_mutex);
+	flush_pending_t element;
+	uint64_t changes = queue.getChanges();
 
-	if (elements_available == 0) {
-		pthread_mutex_unlock(&data_mutex);
-		return;
-	}
+	if (cache_valid && (changes == cache_changes))
+		return cache_timestamp;
 
-	for (i = 0; i < elements_available - 1; i++) {
-		flush_timestamps[i] = flush_timestamps[i + 1];
-		flush_handles[i] = flush_handles[i + 1];
-	}
+	cache_changes = changes;
+	cache_valid = true;
 
-	elements_available--;
+	if (queue.peek(&element))
+		cache_timestamp = element.timestamp;
+	else
+		cache_timestamp = INT64_MAX;
 
-	pthread_mutex_unlock(&data_mutex);
+	return cache_timestamp;
 }
 
-void FlushBufferStack::resetBuffer()
+void FlushBufferStack::removeLastElement()
 {
-	pthread_mutex_lock(&data_mutex);
+	flush_pending_t element;
 
-	elements_available = 0;
+	queue.pop(&element);
+	cache_valid = false;
+}
 
-	pthread_mutex_unlock(&data_mutex);
+void FlushBufferStack::resetBuffer()
+{
+	queue.reset();
 }
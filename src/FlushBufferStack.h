@@ -25,18 +25,29 @@
 #include <pthread.h>
 #include <errno.h>
 
-#define ST_FLUSH_BUFFER_STACK_MAX_ELEMENTS		(300)
+#include "LockFreeQueue.h"
+
+#define ST_FLUSH_BUFFER_STACK_MAX_ELEMENTS		(512)
+
+typedef struct flush_pending {
+	int64_t timestamp;
+	int handle;
+} flush_pending_t;
 
 /*
  * class FlushBufferStack
+ *
+ * Flush events waiting for samples older than the flush to be pushed,
+ * read only by the data thread.
  */
 class FlushBufferStack {
 private:
-	pthread_mutex_t data_mutex;
-	unsigned int elements_available;
+	LockFreeQueue<flush_pending_t, ST_FLUSH_BUFFER_STACK_MAX_ELEMENTS> queue;
 
-	int64_t flush_timestamps[ST_FLUSH_BUFFER_STACK_MAX_ELEMENTS];
-	int flush_handles[ST_FLUSH_BUFFER_STACK_MAX_ELEMENTS];
+	/* data thread only */
+	uint64_t cache_changes;
+	int64_t cache_timestamp;
+	bool cache_valid;
 
 public:
 	FlushBufferStack();
@@ -46,6 +57,7 @@ public:
 	int readLastElement(int64_t *timestamp);
 	unsigned int ElemetsOnStack();
 
+	int64_t nextTimestamp();
 	void removeLastElement(void);
 	void resetBuffer();
 };
@@ -0,0 +1,252 @@
+/*
+ * STMicroelectronics Flush Coalescer Class
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include "FlushCoalescer.h"
+
+FlushCoalescer::FlushCoalescer()
+{
+	pthread_mutex_init(&mutex, NULL);
+	num_devices = 0;
+	num_requests = 0;
+	request_seq = 0;
+	write_seq = 0;
+	write_device = -1;
+	write_deadline = 0;
+	hw_flush_count = 0;
+}
+
+FlushCoalescer::~FlushCoalescer()
+{
+	pthread_mutex_destroy(&mutex);
+}
+
+/**
+ * writeHWFlush() - Write hwfifo_flush, covers all requests queued so far
+ * @device: device to write, mutex must be held.
+ * @now: current time [ns].
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int FlushCoalescer::writeHWFlush(unsigned int device, int64_t now)
+{
+	int err;
+
+	err = devices[device].hw_flush(devices[device].ctx);
+	if (err < 0)
+		return err;
+
+	write_device = device;
+	write_seq = request_seq;
+	write_deadline = now + ST_FLUSH_COALESCER_TIMEOUT_NS;
+	hw_flush_count++;
+
+	return 0;
+}
+
+/**
+ * popRequests() - Remove requests queued up to a sequence number
+ * @seq: last sequence number to remove, mutex must be held.
+ * @done: removed requests, in request order.
+ *
+ * Return value: number of requests removed.
+ **/
+unsigned int FlushCoalescer::popRequests(uint64_t seq, struct completion *done)
+{
+	unsigned int i, num = 0, left = 0;
+
+	for (i = 0; i < num_requests; i++) {
+		if (requests[i].seq <= seq) {
+			done[num].device = requests[i].device;
+			done[num].handle = requests[i].handle;
+			num++;
+		} else {
+			requests[left++] = requests[i];
+		}
+	}
+
+	num_requests = left;
+
+	return num;
+}
+
+void FlushCoalescer::completeRequests(struct completion *done,
+				      unsigned int num, int64_t timestamp)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++)
+		devices[done[i].device].complete(devices[done[i].device].ctx,
+						 done[i].handle, timestamp);
+}
+
+/**
+ * addDevice() - Add IIO device sharing the hw fifo
+ * @ctx: private data passed to callbacks.
+ * @hw_flush: write hwfifo_flush of the device.
+ * @complete: complete flush request of a device consumer.
+ *
+ * Return value: device id on success, negative errno on fail.
+ **/
+int FlushCoalescer::addDevice(void *ctx, hw_flush_t hw_flush,
+			      complete_t complete)
+{
+	int device;
+
+	pthread_mutex_lock(&mutex);
+
+	if (num_devices == ST_FLUSH_COALESCER_MAX_DEVICES) {
+		pthread_mutex_unlock(&mutex);
+		return -ENOMEM;
+	}
+
+	device = num_devices;
+	devices[device].ctx = ctx;
+	devices[device].hw_flush = hw_flush;
+	devices[device].complete = complete;
+	num_devices++;
+
+	pthread_mutex_unlock(&mutex);
+
+	return device;
+}
+
+/**
+ * request() - Queue flush request of a consumer
+ * @device: device id the consumer is flushing.
+ * @handle: handle of the consumer asking for flush.
+ * @now: current time [ns].
+ *
+ * Return value: 1 if hwfifo_flush has been written, 0 if the request
+ * is covered by a write issued later, negative errno on fail.
+ **/
+int FlushCoalescer::request(unsigned int device, int handle, int64_t now)
+{
+	int err;
+
+	pthread_mutex_lock(&mutex);
+
+	if (device >= num_devices) {
+		err = -EINVAL;
+		goto unlock_mutex;
+	}
+
+	if (num_requests == ST_FLUSH_COALESCER_MAX_REQUESTS) {
+		err = -ENOMEM;
+		goto unlock_mutex;
+	}
+
+	requests[num_requests].device = device;
+	requests[num_requests].handle = handle;
+	requests[num_requests].seq = ++request_seq;
+	num_requests++;
+
+	/* issued again at completion of the write in flight */
+	if ((write_device >= 0) && (now < write_deadline)) {
+		err = 0;
+		goto unlock_mutex;
+	}
+
+	err = writeHWFlush(device, now);
+	if (err < 0) {
+		num_requests--;
+		goto unlock_mutex;
+	}
+
+	err = 1;
+
+unlock_mutex:
+	pthread_mutex_unlock(&mutex);
+
+	return err;
+}
+
+/**
+ * complete() - Flush complete event reported by a device
+ * @device: device id reporting the event.
+ * @timestamp: timestamp of flush complete event.
+ * @now: current time [ns].
+ *
+ * Requests queued before the write in flight are completed in request
+ * order, the other ones are covered by a new write.
+ **/
+void FlushCoalescer::complete(unsigned int device, int64_t timestamp,
+			      int64_t now)
+{
+	unsigned int num;
+	struct completion done[ST_FLUSH_COALESCER_MAX_REQUESTS];
+
+	pthread_mutex_lock(&mutex);
+
+	if (write_device != (int)device) {
+		pthread_mutex_unlock(&mutex);
+		return;
+	}
+
+	num = popRequests(write_seq, done);
+	write_device = -1;
+
+	if ((num_requests > 0) && (writeHWFlush(requests[0].device, now) < 0))
+		num += popRequests(request_seq, &done[num]);
+
+	pthread_mutex_unlock(&mutex);
+
+	completeRequests(done, num, timestamp);
+}
+
+/**
+ * cancel() - Device disabled, its flush complete event is lost
+ * @device: device id.
+ * @now: current time [ns].
+ *
+ * Requests of the device are completed now, the fifo has been disabled
+ * with its data. If the write in flight belongs to the device, requests
+ * of other devices are covered by a new write.
+ **/
+void FlushCoalescer::cancel(unsigned int device, int64_t now)
+{
+	unsigned int i, num = 0, left = 0;
+	struct completion done[ST_FLUSH_COALESCER_MAX_REQUESTS];
+
+	pthread_mutex_lock(&mutex);
+
+	for (i = 0; i < num_requests; i++) {
+		if (requests[i].device == device) {
+			done[num].device = requests[i].device;
+			done[num].handle = requests[i].handle;
+			num++;
+		} else {
+			requests[left++] = requests[i];
+		}
+	}
+
+	num_requests = left;
+
+	if (write_device == (int)device) {
+		write_device = -1;
+
+		if ((num_requests > 0) &&
+		    (writeHWFlush(requests[0].device, now) < 0))
+			num += popRequests(request_seq, &done[num]);
+	}
+
+	pthread_mutex_unlock(&mutex);
+
+	completeRequests(done, num, 0);
+}
+
+unsigned int FlushCoalescer::getHWFlushCount()
+{
+	unsigned int count;
+
+	pthread_mutex_lock(&mutex);
+	count = hw_flush_count;
+	pthread_mutex_unlock(&mutex);
+
+	return count;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2015-2016 STMicroelectronics
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ST_FLUSH_COALESCER_H
+#define ST_FLUSH_COALESCER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <errno.h>
+
+#define ST_FLUSH_COALESCER_MAX_DEVICES		(8)
+#define ST_FLUSH_COALESCER_MAX_REQUESTS		(128)
+
+/* hwfifo_flush write considered lost if not completed within this time */
+#define ST_FLUSH_COALESCER_TIMEOUT_NS		(1000000000LL)
+
+/*
+ * class FlushCoalescer
+ *
+ * Flush requests of the IIO devices sharing one physical hw fifo (i.e.
+ * lsm6dsx accelerometer and gyroscope). Writing hwfifo_flush of any of
+ * these devices empties the fifo for all of them, but the flush complete
+ * event is reported only by the device written.
+ *
+ * Only one hwfifo_flush write is in flight at a time. A request completes
+ * when a write issued after the request has been queued is completed:
+ * requests queued while a write is in flight are covered by one new write
+ * issued at its completion, whatever device they belong to. A write not
+ * completed within ST_FLUSH_COALESCER_TIMEOUT_NS is issued again by the
+ * next request.
+ */
+class FlushCoalescer {
+public:
+	typedef int (*hw_flush_t)(void *ctx);
+	typedef void (*complete_t)(void *ctx, int handle, int64_t timestamp);
+
+private:
+	struct device {
+		void *ctx;
+		hw_flush_t hw_flush;
+		complete_t complete;
+	};
+
+	struct request {
+		unsigned int device;
+		int handle;
+		uint64_t seq;
+	};
+
+	struct completion {
+		unsigned int device;
+		int handle;
+	};
+
+	pthread_mutex_t mutex;
+	struct device devices[ST_FLUSH_COALESCER_MAX_DEVICES];
+	unsigned int num_devices;
+	struct request requests[ST_FLUSH_COALESCER_MAX_REQUESTS];
+	unsigned int num_requests;
+	uint64_t request_seq;
+	uint64_t write_seq;
+	int write_device;
+	int64_t write_deadline;
+	unsigned int hw_flush_count;
+
+	int writeHWFlush(unsigned int device, int64_t now);
+	unsigned int popRequests(uint64_t seq, struct completion *done);
+	void completeRequests(struct completion *done, unsigned int num,
+			      int64_t timestamp);
+
+public:
+	FlushCoalescer();
+	~FlushCoalescer();
+
+	int addDevice(void *ctx, hw_flush_t hw_flush, complete_t complete);
+	int request(unsigned int device, int handle, int64_t now);
+	void complete(unsigned int device, int64_t timestamp, int64_t now);
+	void cancel(unsigned int device, int64_t now);
+	unsigned int getHWFlushCount();
+};
+
+#endif /* ST_FLUSH_COALESCER_H */
@@ -86,14 +86,14 @@ int Gyroscope::Enable(int handle, bool enable, bool lock_en_mutex)
 	bool old_status;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	old_status = GetStatus(false);
 
 	err = HWSensorBaseWithPollrate::Enable(handle, enable, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
@@ -102,7 +102,7 @@ int Gyroscope::Enable(int handle, bool enable, bool lock_en_mutex)
 		iNemoEngine_API_gbias_enable(enable);
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 #else /* CONFIG_ST_HAL_GYRO_GBIAS_ESTIMATION_ENABLED */
@@ -116,18 +116,18 @@ int Gyroscope::SetDelay(int handle, int64_t period_ns, int64_t timeout, bool loc
 	int err;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	err = HWSensorBaseWithPollrate::SetDelay(handle, period_ns, timeout, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 #else /* CONFIG_ST_HAL_GYRO_GBIAS_ESTIMATION_ENABLED */
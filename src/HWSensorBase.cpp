@@ -22,34 +22,6 @@
 
 #define HW_SENSOR_BASE_DEELAY_TRANSFER_DATA		(500000000LL)
 
-/**
- * size_from_channelarray() - Calculate the storage size of a scan
- * @channels: the channel info array.
- * @num_channels: number of channels.
- **/
-static int size_from_channelarray(struct device_iio_info_channel *channels,
-				  int num_channels)
-{
-	int bytes = 0, i;
-
-	for (i = 0; i < num_channels; i++) {
-		channels[i].location = 0;
-
-		if (channels[i].bytes == 0)
-			continue;
-
-		if (bytes % channels[i].bytes == 0)
-			channels[i].location = bytes;
-		else
-			channels[i].location = bytes -
-				(bytes % channels[i].bytes) + channels[i].bytes;
-
-		bytes = channels[i].location + channels[i].bytes;
-	}
-
-	return bytes;
-}
-
 /**
  * process_2byte_received() - Return channel data from 2 byte
  * @input: 2 byte of data received from buffer channel.
@@ -229,6 +201,10 @@ HWSensorBase::HWSensorBase(HWSensorBaseCommonData *data, const char *name,
 
 	sensor_t_data.power = power_consumption;
 	sensor_t_data.fifoMaxEventCount = hw_fifo_len;
+	hw_fifo = NULL;
+	hw_fifo_id = -1;
+	android_tap.setMaxBatchLength(hw_fifo_len);
+	sw_batching = false;
 
 #ifdef CONFIG_ST_HAL_FACTORY_CALIBRATION
 	memset(factory_offset, 0, 3 * sizeof(float));
@@ -243,14 +219,26 @@ HWSensorBase::HWSensorBase(HWSensorBaseCommonData *data, const char *name,
 	selftest.available = 0;
 #endif /* CONFIG_ST_HAL_HAS_SELFTEST_FUNCTIONS */
 
-	scan_size = size_from_channelarray(common_data.channels,
-					   common_data.num_channels);
+	scan_size = device_iio_utils::get_scan_size(common_data.channels,
+						    common_data.num_channels);
+
+	sysfs_target.buffer_enable = 0;
+	sysfs_target.sampling_frequency = DEVICE_IIO_SYSFS_VALUE_UNKNOWN;
+	sysfs_target.hw_fifo_watermark = DEVICE_IIO_SYSFS_VALUE_UNKNOWN;
+
+	err = device_iio_utils::open_sysfs_fds(common_data.device_iio_sysfs_path,
+					       &sysfs_fds);
+	if (err < 0) {
+		ALOGE("%s: Failed to open sysfs attributes (%d).",
+		      GetName(), err);
+		goto close_sysfs_fds;
+	}
 
 	err = asprintf(&buffer_path, "/dev/iio:device%d", data->device_iio_dev_num);
 	if (err <= 0) {
 		ALOGE("%s: Failed to allocate iio device path string.",
 		      GetName());
-		goto invalid_this_class;
+		goto close_sysfs_fds;
 	}
 
 	pollfd_iio[0].fd = open(buffer_path, O_RDONLY | O_NONBLOCK);
@@ -309,7 +297,8 @@ HWSensorBase::HWSensorBase(HWSensorBaseCommonData *data, const char *name,
 
 free_buffer_path:
 	free(buffer_path);
-invalid_this_class:
+close_sysfs_fds:
+	device_iio_utils::close_sysfs_fds(&sysfs_fds);
 	InvalidThisClass();
 }
 
@@ -320,6 +309,7 @@ HWSensorBase::~HWSensorBase()
 
 	close(pollfd_iio[0].fd);
 	close(pollfd_iio[1].fd);
+	device_iio_utils::close_sysfs_fds(&sysfs_fds);
 }
 
 #ifdef CONFIG_ST_HAL_HAS_SELFTEST_FUNCTIONS
@@ -357,19 +347,35 @@ selftest_status HWSensorBase::ExecuteSelfTest()
 }
 #endif /* CONFIG_ST_HAL_HAS_SELFTEST_FUNCTIONS */
 
+/**
+ * ApplySysfsConfig() - Write sysfs_target to the iio device
+ *
+ * Must be called with config_mutex held. On failure the device is left
+ * in its previous state and sysfs_target must be restored by caller.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int HWSensorBase::ApplySysfsConfig()
+{
+	return device_iio_utils::apply_sysfs_config(&sysfs_fds, &sysfs_target);
+}
+
 int HWSensorBase::WriteBufferLenght(unsigned int buf_len)
 {
 	int err;
-	unsigned int hw_buf_fifo_len;
+	unsigned int hw_buf_fifo_len, old_watermark;
 
 	if (buf_len == 0)
 		hw_buf_fifo_len = 1;
 	else
 		hw_buf_fifo_len = buf_len;
 
-	err = device_iio_utils::set_hw_fifo_watermark(common_data.device_iio_sysfs_path,
-						      hw_buf_fifo_len);
+	old_watermark = sysfs_target.hw_fifo_watermark;
+	sysfs_target.hw_fifo_watermark = hw_buf_fifo_len;
+
+	err = ApplySysfsConfig();
 	if (err < 0) {
+		sysfs_target.hw_fifo_watermark = old_watermark;
 		ALOGE("%s: Failed to write hw fifo watermark.", GetName());
 		return err;
 	}
@@ -384,7 +390,7 @@ int HWSensorBase::Enable(int handle, bool enable, bool lock_en_mutex)
 
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	old_status = GetStatus(false);
 	old_status_no_handle = GetStatusExcludeHandle(handle);
@@ -394,35 +400,44 @@ int HWSensorBase::Enable(int handle, bool enable, bool lock_en_mutex)
 		goto unlock_mutex;
 
 	if ((enable && !old_status) || (!enable && !old_status_no_handle)) {
-		err = device_iio_utils::enable_sensor(common_data.device_iio_sysfs_path,
-						      GetStatus(false));
+		sysfs_target.buffer_enable = GetStatus(false) ? 1 : 0;
+
+		err = ApplySysfsConfig();
 		if (err < 0) {
+			sysfs_target.buffer_enable = old_status ? 1 : 0;
 			ALOGE("%s: Failed to enable iio sensor device.", GetName());
 			goto restore_status_enable;
 		}
 
-		if (enable)
+		if (enable) {
 			sensor_global_enable = android::elapsedRealtimeNano();
-		else
+		} else {
+			/* completion of a flush in flight is lost with the stream */
+			if (hw_fifo)
+				hw_fifo->cancel(hw_fifo_id, android::elapsedRealtimeNano());
+
 			sensor_global_disable = android::elapsedRealtimeNano();
+		}
 	}
 
 	if (sensor_t_data.handle == handle) {
 		if (enable) {
+			android_tap.reset();
+			ResetChangeDetection();
 			sensor_my_enable = android::elapsedRealtimeNano();
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
-			ALOGD("%s:SAINFO Report: ENABLE.", GetName());
 			WriteSAIReportToPipe();
-			ALOGD("%s : SAI ENABLE Report.", GetName());
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
-		} else
+		} else {
+			android_tap.flush(&output_pipe);
 			sensor_my_disable = android::elapsedRealtimeNano();
+		}
 	}
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
@@ -430,7 +445,7 @@ restore_status_enable:
 	SensorBase::Enable(handle, !enable, false);
 unlock_mutex:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return err;
 }
@@ -449,9 +464,9 @@ int HWSensorBase::SetDelay(int __attribute__((unused))handle,
 		return 0;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
-	if (sensor_t_data.fifoMaxEventCount > 0) {
+	if ((sensor_t_data.fifoMaxEventCount > 0) && !sw_batching) {
 		buf_len = timeout / FREQUENCY_TO_NS(1);
 		if (buf_len > sensor_t_data.fifoMaxEventCount)
 			buf_len = sensor_t_data.fifoMaxEventCount;
@@ -469,13 +484,13 @@ int HWSensorBase::SetDelay(int __attribute__((unused))handle,
 #endif /* CONFIG_ST_HAL_DEBUG_INFO */
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 mutex_unlock:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return err;
 }
@@ -560,102 +575,162 @@ void HWSensorBase::ProcessEvent(struct device_iio_events *event_data)
 	event_type = ((event_data->event_id >> 56) & 0xFF);
 	event_dir = ((event_data->event_id >> 48) & 0x7F);
 
-	if ((event_type == DEVICE_IIO_EV_TYPE_FIFO_FLUSH)  ||
-	    (event_dir == DEVICE_IIO_EV_DIR_FIFO_DATA))
-		ProcessFlushData(sensor_t_data.handle,
-				 event_data->event_timestamp);
+	if (((event_type == DEVICE_IIO_EV_TYPE_FIFO_FLUSH)  ||
+	     (event_dir == DEVICE_IIO_EV_DIR_FIFO_DATA)) && hw_fifo)
+		hw_fifo->complete(hw_fifo_id, event_data->event_timestamp,
+				  android::elapsedRealtimeNano());
 }
 
 
-int HWSensorBase::FlushData(int handle, bool lock_en_mutex)
+/**
+ * SetHWFifo() - Set physical hw fifo the iio device belongs to
+ * @fifo: hw fifo, shared by iio devices flushed together.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int HWSensorBase::SetHWFifo(FlushCoalescer *fifo)
+{
+	int id;
+
+	id = fifo->addDevice(this, HWFifoFlush, HWFifoFlushComplete);
+	if (id < 0)
+		return id;
+
+	hw_fifo = fifo;
+	hw_fifo_id = id;
+
+	return 0;
+}
+
+int HWSensorBase::HWFifoFlush(void *ctx)
+{
+	HWSensorBase *sb = (HWSensorBase *)ctx;
+
+	return device_iio_utils::hw_fifo_flush(&sb->sysfs_fds);
+}
+
+void HWSensorBase::HWFifoFlushComplete(void *ctx, int handle, int64_t timestamp)
+{
+	HWSensorBase *sb = (HWSensorBase *)ctx;
+
+	sb->CompleteFlush(handle, timestamp);
+}
+
+/**
+ * RequestFlush() - Flush hw fifo on behalf of a consumer
+ * @handle: handle of the consumer asking for flush.
+ *
+ * The request is completed by the flush complete event of a hwfifo_flush
+ * write issued after it, dependencies are flushed once per write.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int HWSensorBase::RequestFlush(int handle)
 {
 	int err;
 	unsigned int i;
 
+	err = hw_fifo->request(hw_fifo_id, handle, android::elapsedRealtimeNano());
+	if (err <= 0)
+		return err;
+
+	for (i = 0; i < dependencies.num; i++)
+		dependencies.sb[i]->FlushData(sensor_t_data.handle, false);
+
+	return 0;
+}
+
+int HWSensorBase::FlushData(int handle, bool lock_en_mutex)
+{
+	int err;
+
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	if (GetStatus(false)) {
-		err = flush_requested.writeElement(handle);
-		if (err < 0)
-			goto unlock_mutex;
-
-		if ((GetMinTimeout(false) > 0) &&
+		if (hw_fifo && (GetMinTimeout(false) > 0) &&
 		    (GetMinTimeout(false) < INT64_MAX)) {
-			for (i = 0; i < dependencies.num; i++)
-				dependencies.sb[i]->FlushData(sensor_t_data.handle, true);
-
-			err = device_iio_utils::hw_fifo_flush(common_data.device_iio_sysfs_path);
+			err = RequestFlush(handle);
 			if (err < 0) {
 				ALOGE("%s: Failed to flush hw fifo.",
 				      GetName());
 				goto unlock_mutex;
 			}
 		} else
-			ProcessFlushData(sensor_t_data.handle, 0);
+			CompleteFlush(handle, 0);
 	} else
 		goto unlock_mutex;
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 unlock_mutex:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return -EINVAL;
 }
 
-void HWSensorBase::ProcessFlushData(int __attribute__((unused))handle,
-				    int64_t timestamp)
+/**
+ * CompleteFlush() - Complete flush request of a consumer
+ * @handle: handle of the consumer asking for flush.
+ * @timestamp: timestamp of hw fifo flush completion.
+ **/
+void HWSensorBase::CompleteFlush(int handle, int64_t timestamp)
 {
+	int err;
 	unsigned int i;
-	int err, flush_handle;
-
-	flush_handle = flush_requested.readElement();
-	if (flush_handle < 0)
-		return;
 
 	pthread_mutex_lock(&sample_in_processing_mutex);
 
 	if (timestamp > sample_in_processing_timestamp) {
-		err = flush_stack.writeElement(flush_handle, timestamp);
+		err = flush_stack.writeElement(handle, timestamp);
 		if (err < 0)
 			ALOGE("%s: Failed to write Flush event into stack.",
 			      GetName());
 	} else {
-		if (flush_handle == sensor_t_data.handle) {
+		if (handle == sensor_t_data.handle) {
 			WriteFlushEventToPipe();
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
-			ALOGD("%s:SAINFO Report: FLUSH.", GetName());
 			WriteSAIReportToPipe();
-			ALOGD("%s : SAI FLUSH Report.", GetName());
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 		} else {
 			for (i = 0; i < push_data.num; i++)
-				push_data.sb[i]->ProcessFlushData(flush_handle,
-								  timestamp);
+				push_data.sb[i]->ProcessFlushData(handle, timestamp);
 		}
 	}
 
 	pthread_mutex_unlock(&sample_in_processing_mutex);
 }
 
+/**
+ * ProcessFlushData() - Flush completed by a dependency
+ * @handle: unused.
+ * @timestamp: unused.
+ *
+ * Requests of this sensor are completed by its own hw fifo flush
+ * complete event, completion of dependencies carries no information.
+ **/
+void HWSensorBase::ProcessFlushData(int __attribute__((unused))handle,
+				    int64_t __attribute__((unused))timestamp)
+{
+}
 
 void HWSensorBase::ThreadDataTask()
 {
 	uint8_t *data;
 	unsigned int hw_fifo_len;
+	struct pollfd pollfd_data[3];
 	SensorBaseData sensor_data;
-	int err, i, read_size, flush_handle;
+	int err, i, read_size, flush_handle, nfds = 2;
 	int64_t timestamp_flush, timestamp_odr_switch, new_pollrate = 0;
-	int64_t old_pollrate = 0;
+	int64_t old_pollrate = 0, armed_deadline = INT64_MAX;
 
-	if (sensor_t_data.fifoMaxEventCount > 0)
+	if ((sensor_t_data.fifoMaxEventCount > 0) && !sw_batching)
 		hw_fifo_len = sensor_t_data.fifoMaxEventCount;
 	else
 		hw_fifo_len = 1;
@@ -667,12 +742,36 @@ void HWSensorBase::ThreadDataTask()
 		return;
 	}
 
+#ifdef CONFIG_ST_HAL_THREAD_MLOCK_ENABLED
+	/* no page fault on first samples */
+	memset(data, 0, hw_fifo_len * scan_size * HW_SENSOR_BASE_DEFAULT_IIO_BUFFER_LEN);
+#endif /* CONFIG_ST_HAL_THREAD_MLOCK_ENABLED */
+
+	pollfd_data[0] = pollfd_iio[0];
+	GetThreadStopPollfd(&pollfd_data[1]);
+
+	/* android output tap may hold a batch (sw batching or own timeout) */
+	if ((sensor_t_data.fifoMaxEventCount > 1) &&
+	    (CreateBatchTimer(&pollfd_data[2]) >= 0))
+		nfds = 3;
+
 	while (true) {
-		err = poll(&pollfd_iio[0], 1, -1);
-		if (err <= 0)
+		err = poll(pollfd_data, nfds, SENSOR_BASE_THREAD_POLL_TIMEOUT);
+		if (err <= 0) {
+			if ((err == 0) && ThreadIdleExpired(false))
+				break;
+
 			continue;
+		}
+
+		/* HAL is being closed */
+		if (pollfd_data[1].revents & POLLIN)
+			break;
 
-		if (pollfd_iio[0].revents & POLLIN) {
+		if ((nfds > 2) && (pollfd_data[2].revents & POLLIN))
+			ProcessBatchTimer(pollfd_data[2].fd, &armed_deadline);
+
+		if (pollfd_data[0].revents & POLLIN) {
 			read_size = read(pollfd_iio[0].fd,
 					 data,
 					 hw_fifo_len * scan_size * HW_SENSOR_BASE_DEFAULT_IIO_BUFFER_LEN);
@@ -691,40 +790,69 @@ void HWSensorBase::ThreadDataTask()
 				sample_in_processing_timestamp = sensor_data.timestamp;
 				pthread_mutex_unlock(&sample_in_processing_mutex);
 
-				timestamp_odr_switch = odr_switch.readLastElement(&new_pollrate);
-				if (sensor_data.timestamp > timestamp_odr_switch) {
-					sensor_data.pollrate_ns = new_pollrate;
-					old_pollrate = new_pollrate;
-					odr_switch.removeLastElement();
-				} else {
-					sensor_data.pollrate_ns = old_pollrate;
+				sensor_data.pollrate_ns = old_pollrate;
+				sensor_data.flush_event_handle = -1;
+
+				/* common case: nothing pending, no queue access */
+				if (sensor_data.timestamp > odr_switch.nextTimestamp()) {
+					timestamp_odr_switch = odr_switch.readLastElement(&new_pollrate);
+					if ((timestamp_odr_switch >= 0) &&
+					    (sensor_data.timestamp > timestamp_odr_switch)) {
+						sensor_data.pollrate_ns = new_pollrate;
+						old_pollrate = new_pollrate;
+						odr_switch.removeLastElement();
+					}
 				}
 
-				flush_handle = flush_stack.readLastElement(&timestamp_flush);
-				if ((flush_handle >= 0) && (timestamp_flush <= sensor_data.timestamp)) {
-					sensor_data.flush_event_handle = flush_handle;
-					flush_stack.removeLastElement();
-				} else {
-					sensor_data.flush_event_handle = -1;
+				if (sensor_data.timestamp >= flush_stack.nextTimestamp()) {
+					flush_handle = flush_stack.readLastElement(&timestamp_flush);
+					if ((flush_handle >= 0) && (timestamp_flush <= sensor_data.timestamp)) {
+						sensor_data.flush_event_handle = flush_handle;
+						flush_stack.removeLastElement();
+					}
 				}
 
 				ProcessData(&sensor_data);
 			}
+
+#ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+			FlushDirectChannelBatch();
+#endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
+
+			if (nfds > 2)
+				ArmBatchTimer(pollfd_data[2].fd, &armed_deadline);
 		}
 	}
+
+	if (nfds > 2)
+		close(pollfd_data[2].fd);
+
+	free(data);
 }
 
 void HWSensorBase::ThreadEventsTask()
 {
 	int err, i, read_size;
+	struct pollfd pollfd_events[2];
 	struct device_iio_events event_data[10];
 
+	pollfd_events[0] = pollfd_iio[1];
+	GetThreadStopPollfd(&pollfd_events[1]);
+
 	while (true) {
-		err = poll(&pollfd_iio[1], 1, -1);
-		if (err <= 0)
+		err = poll(pollfd_events, 2, SENSOR_BASE_THREAD_POLL_TIMEOUT);
+		if (err <= 0) {
+			if ((err == 0) && ThreadIdleExpired(true))
+				break;
+
 			continue;
+		}
+
+		/* HAL is being closed */
+		if (pollfd_events[1].revents & POLLIN)
+			break;
 
-		if (pollfd_iio[1].revents & POLLIN) {
+		if (pollfd_events[0].revents & POLLIN) {
 			read_size = read(pollfd_iio[1].fd, event_data,
 					 10 * sizeof(struct device_iio_events));
 			if (read_size <= 0) {
@@ -739,6 +867,26 @@ void HWSensorBase::ThreadEventsTask()
 	}
 }
 
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+/**
+ * GetThreadPriority() - Get real-time priority of data thread
+ *
+ * Return value: priority, 0 means default scheduling.
+ **/
+int HWSensorBase::GetThreadPriority()
+{
+	switch (sensor_t_data.type) {
+	case SENSOR_TYPE_ACCELEROMETER:
+	case SENSOR_TYPE_MAGNETIC_FIELD:
+	case SENSOR_TYPE_GYROSCOPE:
+		return CONFIG_ST_HAL_THREAD_MOTION_PRIORITY;
+
+	default:
+		return CONFIG_ST_HAL_THREAD_ENVIRONMENT_PRIORITY;
+	}
+}
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_MARSHMALLOW_VERSION)
 int HWSensorBase::InjectionMode(bool enable)
 {
@@ -841,6 +989,18 @@ HWSensorBaseWithPollrate::HWSensorBaseWithPollrate(HWSensorBaseCommonData *data,
 #if (CONFIG_ST_HAL_ANDROID_VERSION > ST_HAL_KITKAT_VERSION)
 	sensor_t_data.maxDelay = FREQUENCY_TO_US(min_sampling_frequency);
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
+
+#if (CONFIG_ST_HAL_SW_BATCHING_FIFO_LEN > 0)
+	/*
+	 * no hw FIFO available (ie. pressure, humidity, temperature):
+	 * batching is emulated by android output tap.
+	 */
+	if (hw_fifo_len <= 1) {
+		sw_batching = true;
+		sensor_t_data.fifoMaxEventCount = CONFIG_ST_HAL_SW_BATCHING_FIFO_LEN;
+		android_tap.setMaxBatchLength(CONFIG_ST_HAL_SW_BATCHING_FIFO_LEN);
+	}
+#endif /* CONFIG_ST_HAL_SW_BATCHING_FIFO_LEN */
 }
 
 HWSensorBaseWithPollrate::~HWSensorBaseWithPollrate()
@@ -855,14 +1015,15 @@ int HWSensorBaseWithPollrate::SetDelay(int handle, int64_t period_ns,
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_INFO)
 	bool message = false;
 #endif /* CONFIG_ST_HAL_DEBUG_INFO */
-	unsigned int sampling_frequency, buf_len;
+	unsigned int sampling_frequency, buf_len, old_sampling_frequency;
 	int64_t min_pollrate_ns, min_timeout_ns = 0, timestamp;
+	int64_t old_period_ns, old_timeout;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
-	if ((sensors_pollrates[handle] == period_ns) &&
-	    (sensors_timeout[handle] == timeout)) {
+	rates.get(handle, &old_period_ns, &old_timeout);
+	if ((old_period_ns == period_ns) && (old_timeout == timeout)) {
 		err = 0;
 		goto mutex_unlock;
 	}
@@ -899,9 +1060,12 @@ int HWSensorBaseWithPollrate::SetDelay(int handle, int64_t period_ns,
 		i--;
 
 	if (current_min_pollrate != min_pollrate_ns) {
-		err = device_iio_utils::set_sampling_frequency(common_data.device_iio_sysfs_path,
-							       sampling_frequency_available.freq[i]);
+		old_sampling_frequency = sysfs_target.sampling_frequency;
+		sysfs_target.sampling_frequency = sampling_frequency_available.freq[i];
+
+		err = ApplySysfsConfig();
 		if (err < 0) {
+			sysfs_target.sampling_frequency = old_sampling_frequency;
 			ALOGE("%s: Failed to write sampling frequency to iio device.", GetName());
 			goto mutex_unlock;
 		}
@@ -914,17 +1078,22 @@ int HWSensorBaseWithPollrate::SetDelay(int handle, int64_t period_ns,
 			ALOGE("%s: Failed to write new odr on stack.",
 			      GetName());
 
-		if (handle == sensor_t_data.handle)
-			AddNewPollrate(timestamp, period_ns);
-
 		current_min_pollrate = min_pollrate_ns;
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_INFO)
 		message = true;
 #endif /* CONFIG_ST_HAL_DEBUG_INFO */
 
-	}
+	} else
+		timestamp = android::elapsedRealtimeNano();
+
+	/*
+	 * android output tap is decimated from the hw stream, its own period
+	 * must be updated even if the minimum period did not change.
+	 */
+	if (handle == sensor_t_data.handle)
+		AddNewPollrate(timestamp, period_ns);
 
-	if (sensor_t_data.fifoMaxEventCount > 0) {
+	if ((sensor_t_data.fifoMaxEventCount > 0) && !sw_batching) {
 		min_timeout_ns = GetMinTimeout(false);
 		if (min_timeout_ns < HW_SENSOR_BASE_DEELAY_TRANSFER_DATA)
 			min_timeout_ns = 0;
@@ -955,13 +1124,13 @@ int HWSensorBaseWithPollrate::SetDelay(int handle, int64_t period_ns,
 #endif /* CONFIG_ST_HAL_DEBUG_INFO */
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 mutex_unlock:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return err;
 }
@@ -969,83 +1138,82 @@ mutex_unlock:
 int HWSensorBaseWithPollrate::FlushData(int handle, bool lock_en_mutex)
 {
 	int err;
-	unsigned int i;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	if (GetStatus(false)) {
-		err = flush_requested.writeElement(handle);
-		if (err < 0)
-			goto unlock_mutex;
-
-		if ((GetMinTimeout(false) > 0) && (GetMinTimeout(false) < INT64_MAX)) {
-			for (i = 0; i < dependencies.num; i++)
-				dependencies.sb[i]->FlushData(sensor_t_data.handle, true);
-
-			err = device_iio_utils::hw_fifo_flush(common_data.device_iio_sysfs_path);
+		/* software batched data are flushed by flush complete event */
+		if (hw_fifo && (GetMinTimeout(false) > 0) &&
+		    (GetMinTimeout(false) < INT64_MAX) && !sw_batching) {
+			err = RequestFlush(handle);
 			if (err < 0) {
 				ALOGE("%s: Failed to flush hw fifo.", GetName());
 				goto unlock_mutex;
 			}
 		} else
-			ProcessFlushData(sensor_t_data.handle, android::elapsedRealtimeNano());
+			CompleteFlush(handle, android::elapsedRealtimeNano());
 	} else
 		goto unlock_mutex;
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 unlock_mutex:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return -EINVAL;
 }
 
+#ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+/**
+ * PlanDirectChannelPeriod() - Pick the odr feeding a direct channel
+ * @period: nominal period of the channel rate level.
+ *
+ * Return value: period of the selected odr.
+ **/
+int64_t HWSensorBaseWithPollrate::PlanDirectChannelPeriod(int64_t period)
+{
+	return DirectChannelPlanner::planPeriod(period,
+					sampling_frequency_available.freq,
+					sampling_frequency_available.length);
+}
+#endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
+
 void HWSensorBaseWithPollrate::WriteDataToPipe(int64_t hw_pollrate)
 {
 	int err;
-	float temp;
 	bool odr_changed = false;
 	int64_t timestamp_change = 0, new_pollrate = 0;
 
 	err = CheckLatestNewPollrate(&timestamp_change, &new_pollrate);
 	if ((err >= 0) && (sensor_event.timestamp > timestamp_change)) {
 		current_real_pollrate = new_pollrate;
+		android_tap.setPeriod(current_real_pollrate);
 		DeleteLatestNewPollrate();
 		odr_changed = true;
 	}
 
-	if (ValidDataToPush(sensor_event.timestamp)) {
-		temp = (float)current_real_pollrate / hw_pollrate;
-		decimator = (int)(temp + (temp / 20));
-		samples_counter++;
-
-		if (decimator == 0)
-			decimator = 1;
-
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
-		if (mDirectChannel != nullptr) {
-			if (mDirectChannelLock.tryLock() == android::NO_ERROR) {
-				mDirectChannel->write(&sensor_event);
-				mDirectChannelLock.unlock();
-			}
-		}
+	/* direct channels are consumers on their own, not tied to android enable */
+	if (HasDirectChannel())
+		WriteDirectChannelEvent(&sensor_event, hw_pollrate);
 #endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 
-		if (((samples_counter % decimator) == 0) || odr_changed) {
-			err = write(write_pipe_fd, &sensor_event, sizeof(sensors_event_t));
-			if (err <= 0) {
+	if (ValidDataToPush(sensor_event.timestamp)) {
+		/* change detection is used only by single channel sensors */
+		if (android_tap.decimate(sensor_event.timestamp, hw_pollrate, odr_changed) &&
+		    ChangeDetected(sensor_event.data[0], sensor_event.timestamp)) {
+			err = android_tap.writeEvent(&output_pipe, &sensor_event);
+			if (err < 0) {
 				ALOGE("%s: Failed to write sensor data to pipe. (errno: %d)",
-				      android_name, -errno);
-				samples_counter--;
+				      android_name, err);
 				return;
 			}
 
-			samples_counter = 0;
 			last_data_timestamp = sensor_event.timestamp;
 
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_EXTRA_VERBOSE)
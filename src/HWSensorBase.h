@@ -22,6 +22,7 @@
 #include <math.h>
 
 #include "SensorBase.h"
+#include "FlushCoalescer.h"
 
 extern "C" {
 	#include "utils.h"
@@ -62,8 +63,11 @@ private:
 protected:
 	ssize_t scan_size;
 	struct pollfd pollfd_iio[2];
-	FlushRequested flush_requested;
+	FlushCoalescer *hw_fifo;
+	int hw_fifo_id;
 	HWSensorBaseCommonData common_data;
+	struct device_iio_sysfs_fds sysfs_fds;
+	struct device_iio_sysfs_config sysfs_target;
 	ChangeODRTimestampStack odr_switch;
 #ifdef CONFIG_ST_HAL_FACTORY_CALIBRATION
 	bool factory_calibration_updated;
@@ -77,7 +81,13 @@ protected:
 	uint8_t *injection_data;
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 	bool has_event_channels;
+	bool sw_batching;
 
+	int ApplySysfsConfig();
+	int RequestFlush(int handle);
+	void CompleteFlush(int handle, int64_t timestamp);
+	static int HWFifoFlush(void *ctx);
+	static void HWFifoFlushComplete(void *ctx, int handle, int64_t timestamp);
 	int WriteBufferLenght(unsigned int buf_len);
 
 public:
@@ -100,6 +110,7 @@ public:
 	virtual void RemoveSensorDependency(SensorBase *p);
 
 	int ApplyFactoryCalibrationData(char *filename, time_t *last_modification);
+	int SetHWFifo(FlushCoalescer *fifo);
 
 	virtual void ProcessEvent(struct device_iio_events *event_data);
 	virtual int FlushData(int handle, bool lock_en_mute);
@@ -113,6 +124,9 @@ public:
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 	bool hasEventChannels() { return has_event_channels; }
 	bool hasDataChannels() { return common_data.num_channels > 0; }
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+	virtual int GetThreadPriority();
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
 };
 
 
@@ -134,6 +148,10 @@ public:
 			     bool lock_en_mute);
 	virtual int FlushData(int handle, bool lock_en_mute);
 	virtual void WriteDataToPipe(int64_t hw_pollrate);
+
+#ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+	virtual int64_t PlanDirectChannelPeriod(int64_t period);
+#endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 };
 
 #endif /* ST_HWSENSOR_BASE_H */
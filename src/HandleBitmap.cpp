@@ -0,0 +1,119 @@
+/*
+ * STMicroelectronics Handle Bitmap Class
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "HandleBitmap.h"
+
+HandleBitmap::HandleBitmap()
+{
+	default_word = 0;
+	words = &default_word;
+	words_num = 1;
+	bits_set = 0;
+}
+
+HandleBitmap::~HandleBitmap()
+{
+	if (words != &default_word)
+		free(words);
+}
+
+int HandleBitmap::Grow(unsigned int new_words_num)
+{
+	uint64_t *new_words;
+
+	new_words = (uint64_t *)calloc(new_words_num, sizeof(uint64_t));
+	if (!new_words)
+		return -ENOMEM;
+
+	memcpy(new_words, words, words_num * sizeof(uint64_t));
+
+	if (words != &default_word)
+		free(words);
+
+	words = new_words;
+	words_num = new_words_num;
+
+	return 0;
+}
+
+/**
+ * set() - Add handle to the set
+ * @handle: sensor handle.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int HandleBitmap::set(int handle)
+{
+	int err;
+	uint64_t bit;
+	unsigned int word;
+
+	if (handle < 0)
+		return -EINVAL;
+
+	word = handle / ST_HANDLE_BITMAP_WORD_BITS;
+	bit = 1ULL << (handle % ST_HANDLE_BITMAP_WORD_BITS);
+
+	if (word >= words_num) {
+		err = Grow(word + 1);
+		if (err < 0)
+			return err;
+	}
+
+	if (!(words[word] & bit)) {
+		words[word] |= bit;
+		bits_set++;
+	}
+
+	return 0;
+}
+
+void HandleBitmap::clear(int handle)
+{
+	uint64_t bit;
+	unsigned int word;
+
+	if (handle < 0)
+		return;
+
+	word = handle / ST_HANDLE_BITMAP_WORD_BITS;
+	bit = 1ULL << (handle % ST_HANDLE_BITMAP_WORD_BITS);
+
+	if ((word < words_num) && (words[word] & bit)) {
+		words[word] &= ~bit;
+		bits_set--;
+	}
+}
+
+bool HandleBitmap::test(int handle)
+{
+	unsigned int word;
+
+	if (handle < 0)
+		return false;
+
+	word = handle / ST_HANDLE_BITMAP_WORD_BITS;
+	if (word >= words_num)
+		return false;
+
+	return (words[word] & (1ULL << (handle % ST_HANDLE_BITMAP_WORD_BITS))) != 0;
+}
+
+bool HandleBitmap::any()
+{
+	return bits_set > 0;
+}
+
+bool HandleBitmap::anyExcept(int handle)
+{
+	return bits_set > (test(handle) ? 1U : 0U);
+}
@@ -15,36 +15,38 @@
  * limitations under the License.
  */
 
-#ifndef ST_FLUSH_REQUESTED_STACK_H
-#define ST_FLUSH_REQUESTED_STACK_H
-
-#include <sys/cdefs.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <time.h>
-#include <pthread.h>
+#ifndef ST_HANDLE_BITMAP_H
+#define ST_HANDLE_BITMAP_H
+
+#include <stdint.h>
 #include <errno.h>
 
-#define ST_FLUSH_REQUESTED_STACK_MAX_ELEMENTS		(300)
+#define ST_HANDLE_BITMAP_WORD_BITS		(64)
 
 /*
- * class FlushRequested
+ * class HandleBitmap
+ *
+ * Set of sensor handles. First 64 handles need no allocation, storage
+ * grows when an higher handle is set.
  */
-class FlushRequested {
+class HandleBitmap {
 private:
-	pthread_mutex_t data_mutex;
-	unsigned int elements_available;
+	uint64_t default_word;
+	uint64_t *words;
+	unsigned int words_num;
+	unsigned int bits_set;
 
-	int handles[ST_FLUSH_REQUESTED_STACK_MAX_ELEMENTS];
+	int Grow(unsigned int new_words_num);
 
 public:
-	FlushRequested();
-	~FlushRequested();
-
-	int writeElement(int handle);
-	int readElement(void);
-
-	void resetBuffer();
+	HandleBitmap();
+	~HandleBitmap();
+
+	int set(int handle);
+	void clear(int handle);
+	bool test(int handle);
+	bool any();
+	bool anyExcept(int handle);
 };
 
-#endif /* ST_FLUSH_REQUESTED_STACK_H */
+#endif /* ST_HANDLE_BITMAP_H */
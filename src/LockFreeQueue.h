@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2015-2016 STMicroelectronics
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ST_LOCK_FREE_QUEUE_H
+#define ST_LOCK_FREE_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * class LockFreeQueue
+ *
+ * Bounded FIFO queue, multiple producers and multiple consumers, no
+ * locks. Every cell carries a sequence number telling if it is ready
+ * to be written (sequence == position) or read (sequence == position + 1).
+ * peek() is allowed only if the queue has a single consumer.
+ * reset() can be called by any thread: elements pushed before it are
+ * discarded by the consumer, elements pushed after it are kept.
+ * getChanges() counts completed push() and reset(), a consumer can keep
+ * what it peeked until the counter moves.
+ */
+template <typename T, unsigned int N>
+class LockFreeQueue {
+	static_assert((N > 1) && ((N & (N - 1)) == 0), "queue size must be a power of 2");
+
+private:
+	struct Cell {
+		std::atomic<uint64_t> sequence;
+		T data;
+	};
+
+	Cell cells[N];
+	std::atomic<uint64_t> enqueue_pos;
+	std::atomic<uint64_t> dequeue_pos;
+	std::atomic<uint64_t> reset_pos;
+	std::atomic<uint64_t> changes;
+
+	bool PopElement(T *data)
+	{
+		Cell *cell;
+		int64_t diff;
+		uint64_t pos = dequeue_pos.load(std::memory_order_relaxed);
+
+		while (true) {
+			cell = &cells[pos & (N - 1)];
+			diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)(pos + 1);
+			if (diff == 0) {
+				if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				return false;
+			} else
+				pos = dequeue_pos.load(std::memory_order_relaxed);
+		}
+
+		*data = cell->data;
+		cell->sequence.store(pos + N, std::memory_order_release);
+
+		return true;
+	}
+
+	void DropResetElements()
+	{
+		T discard;
+
+		while (dequeue_pos.load(std::memory_order_relaxed) <
+		       reset_pos.load(std::memory_order_acquire)) {
+			if (!PopElement(&discard))
+				break;
+		}
+	}
+
+public:
+	LockFreeQueue()
+	{
+		unsigned int i;
+
+		for (i = 0; i < N; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+
+		enqueue_pos.store(0, std::memory_order_relaxed);
+		dequeue_pos.store(0, std::memory_order_relaxed);
+		reset_pos.store(0, std::memory_order_relaxed);
+		changes.store(0, std::memory_order_relaxed);
+	}
+
+	/**
+	 * push() - Append element at the end of the queue
+	 * @data: element to append.
+	 *
+	 * Return value: true on success, false if queue is full.
+	 **/
+	bool push(const T &data)
+	{
+		Cell *cell;
+		int64_t diff;
+		uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+		while (true) {
+			cell = &cells[pos & (N - 1)];
+			diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)pos;
+			if (diff == 0) {
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				return false;
+			} else
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+
+		cell->data = data;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		changes.fetch_add(1, std::memory_order_release);
+
+		return true;
+	}
+
+	/**
+	 * pop() - Remove first element of the queue
+	 * @data: removed element.
+	 *
+	 * Return value: true on success, false if queue is empty.
+	 **/
+	bool pop(T *data)
+	{
+		DropResetElements();
+
+		return PopElement(data);
+	}
+
+	/**
+	 * peek() - Read first element without removing it (single consumer)
+	 * @data: first element.
+	 *
+	 * Return value: true on success, false if queue is empty.
+	 **/
+	bool peek(T *data)
+	{
+		Cell *cell;
+		uint64_t pos;
+
+		DropResetElements();
+
+		pos = dequeue_pos.load(std::memory_order_relaxed);
+		cell = &cells[pos & (N - 1)];
+		if (cell->sequence.load(std::memory_order_acquire) != pos + 1)
+			return false;
+
+		*data = cell->data;
+
+		return true;
+	}
+
+	void reset()
+	{
+		reset_pos.store(enqueue_pos.load(std::memory_order_acquire),
+				std::memory_order_release);
+		changes.fetch_add(1, std::memory_order_release);
+	}
+
+	uint64_t getChanges()
+	{
+		return changes.load(std::memory_order_acquire);
+	}
+
+	unsigned int size()
+	{
+		uint64_t head = dequeue_pos.load(std::memory_order_relaxed);
+		uint64_t tail = enqueue_pos.load(std::memory_order_relaxed);
+
+		return (tail > head) ? (unsigned int)(tail - head) : 0;
+	}
+};
+
+#endif /* ST_LOCK_FREE_QUEUE_H */
@@ -69,12 +69,12 @@ int Magnetometer::Enable(int handle, bool enable, bool lock_en_mutex)
 	int err;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	err = HWSensorBaseWithPollrate::Enable(handle, enable, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
@@ -85,7 +85,7 @@ int Magnetometer::Enable(int handle, bool enable, bool lock_en_mutex)
 		ST_MagCalibration_API_DeInit(CALIBRATION_PERIOD_MS);
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 #else /* CONFIG_ST_HAL_MAGN_CALIB_ENABLED */
@@ -0,0 +1,185 @@
+/*
+ * STMicroelectronics Rate Table Class
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#define __STDC_LIMIT_MACROS
+#define __STDINT_LIMITS
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RateTable.h"
+
+RateTable::RateTable()
+{
+	entries = default_entries;
+	num = 0;
+	max = ST_RATE_TABLE_DEFAULT_ENTRIES;
+
+	min_period = INT64_MAX;
+	min_timeout = INT64_MAX;
+}
+
+RateTable::~RateTable()
+{
+	if (entries != default_entries)
+		free(entries);
+}
+
+int RateTable::FindEntry(int handle)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		if (entries[i].handle == handle)
+			return i;
+	}
+
+	return -ENOENT;
+}
+
+int RateTable::Grow()
+{
+	rate_table_entry *new_entries;
+
+	new_entries = (rate_table_entry *)malloc(2 * max * sizeof(rate_table_entry));
+	if (!new_entries)
+		return -ENOMEM;
+
+	memcpy(new_entries, entries, num * sizeof(rate_table_entry));
+
+	if (entries != default_entries)
+		free(entries);
+
+	entries = new_entries;
+	max *= 2;
+
+	return 0;
+}
+
+void RateTable::RescanMin()
+{
+	unsigned int i;
+
+	min_period = INT64_MAX;
+	min_timeout = INT64_MAX;
+
+	for (i = 0; i < num; i++) {
+		if ((entries[i].period > 0) && (entries[i].period < min_period))
+			min_period = entries[i].period;
+
+		if (entries[i].timeout < min_timeout)
+			min_timeout = entries[i].timeout;
+	}
+}
+
+/**
+ * set() - Set period and timeout requested by a consumer
+ * @handle: consumer handle.
+ * @period: period in ns, 0 means no request.
+ * @timeout: max report latency in ns, INT64_MAX means no request.
+ *
+ * Storage never shrinks: restoring a value previously set never fails.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int RateTable::set(int handle, int64_t period, int64_t timeout)
+{
+	int err, index;
+	bool rescan = false;
+	int64_t old_period = 0, old_timeout = INT64_MAX;
+
+	index = FindEntry(handle);
+	if (index >= 0) {
+		old_period = entries[index].period;
+		old_timeout = entries[index].timeout;
+	}
+
+	if ((period == old_period) && (timeout == old_timeout))
+		return 0;
+
+	if ((period == 0) && (timeout == INT64_MAX)) {
+		/* entry removed, last one takes its place */
+		num--;
+		if ((unsigned int)index != num)
+			memcpy(&entries[index], &entries[num], sizeof(rate_table_entry));
+	} else {
+		if (index < 0) {
+			if (num == max) {
+				err = Grow();
+				if (err < 0)
+					return err;
+			}
+
+			index = num;
+			entries[index].handle = handle;
+			num++;
+		}
+
+		entries[index].period = period;
+		entries[index].timeout = timeout;
+	}
+
+	/* current min released or raised by its owner */
+	if ((old_period > 0) && (old_period == min_period) &&
+	    ((period == 0) || (period > old_period)))
+		rescan = true;
+
+	if ((old_timeout < INT64_MAX) && (old_timeout == min_timeout) &&
+	    (timeout > old_timeout))
+		rescan = true;
+
+	if (rescan) {
+		RescanMin();
+		return 0;
+	}
+
+	if ((period > 0) && (period < min_period))
+		min_period = period;
+
+	if (timeout < min_timeout)
+		min_timeout = timeout;
+
+	return 0;
+}
+
+void RateTable::get(int handle, int64_t *period, int64_t *timeout)
+{
+	int index;
+
+	index = FindEntry(handle);
+	if (index < 0) {
+		*period = 0;
+		*timeout = INT64_MAX;
+		return;
+	}
+
+	*period = entries[index].period;
+	*timeout = entries[index].timeout;
+}
+
+/**
+ * getMinPeriod() - Get min period requested by consumers
+ *
+ * Return value: min period in ns, 0 if no period is requested.
+ **/
+int64_t RateTable::getMinPeriod()
+{
+	return min_period == INT64_MAX ? 0 : min_period;
+}
+
+/**
+ * getMinTimeout() - Get min max report latency requested by consumers
+ *
+ * Return value: min timeout in ns, INT64_MAX if no timeout is requested.
+ **/
+int64_t RateTable::getMinTimeout()
+{
+	return min_timeout;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2015-2016 STMicroelectronics
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ST_RATE_TABLE_H
+#define ST_RATE_TABLE_H
+
+#include <stdint.h>
+#include <errno.h>
+
+#define ST_RATE_TABLE_DEFAULT_ENTRIES		(4)
+
+struct rate_table_entry {
+	int handle;
+	int64_t period;
+	int64_t timeout;
+} typedef rate_table_entry;
+
+/*
+ * class RateTable
+ *
+ * Period and max report latency requested by every consumer of a sensor
+ * (itself, dependent virtual sensors, direct channels). Only consumers
+ * with a request are stored, minimum values are kept updated on every
+ * change and rescanned only when the current minimum is released.
+ * Period 0 and timeout INT64_MAX mean no request.
+ */
+class RateTable {
+private:
+	rate_table_entry default_entries[ST_RATE_TABLE_DEFAULT_ENTRIES];
+	rate_table_entry *entries;
+	unsigned int num;
+	unsigned int max;
+
+	int64_t min_period;
+	int64_t min_timeout;
+
+	int FindEntry(int handle);
+	int Grow();
+	void RescanMin();
+
+public:
+	RateTable();
+	~RateTable();
+
+	int set(int handle, int64_t period, int64_t timeout);
+	void get(int handle, int64_t *period, int64_t *timeout);
+	int64_t getMinPeriod();
+	int64_t getMinTimeout();
+};
+
+#endif /* ST_RATE_TABLE_H */
@@ -23,6 +23,7 @@
 #endif /* use log/log.h start from android 8 major version */
 #include <sys/mman.h>
 #include <memory>
+#include <atomic>
 #include "RingBuffer.h"
 
 bool DirectChannelBase::isValid()
@@ -35,37 +36,26 @@ int DirectChannelBase::getError()
     return mError;
 }
 
-/* Write one event into Ring Buffer. */
+/* Write one event into Ring Buffer, caller is the only writer. */
 void DirectChannelBase::write(const sensors_event_t * ev)
 {
-    if (isValid()) {
+    if (isValid())
         mBuffer->write(ev, 1);
-    }
-}
-
-RingBuffer::RingBuffer(void* buf, size_t size) : mData((sensors_event_t *)buf),
-                mSize(size/sizeof(sensors_event_t)), mWritePos(0), mCounter(1)
-{
-    memset(mData, 0, size);
 }
 
-RingBuffer::~RingBuffer()
+/* Write a batch of events into Ring Buffer, caller is the only writer. */
+void DirectChannelBase::write(const sensors_event_t * ev, size_t size)
 {
-    memset(mData, 0, mSize*sizeof(sensors_event_t));
+    if (isValid())
+        mBuffer->write(ev, size);
 }
 
-void RingBuffer::write(const sensors_event_t *ev, size_t size)
+/* Write a batch of events into Ring Buffer shared by several writers. */
+void DirectChannelBase::writeShared(const sensors_event_t * ev, size_t size)
 {
-    if (!mSize)
-        return;
-
-    while(size--) {
-        mData[mWritePos] = *(ev++);
-        mData[mWritePos].reserved0 = mCounter++;
-
-        /* Override old samples. */
-        if (++mWritePos >= mSize)
-            mWritePos = 0;
+    if (isValid()) {
+        android::Mutex::Autolock autoLock(mWriteLock);
+        mBuffer->write(ev, size);
     }
 }
 
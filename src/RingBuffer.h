@@ -17,20 +17,7 @@
 #include <hardware/gralloc1.h>
 #include <utils/Singleton.h>
 
-struct RingBuffer {
-	RingBuffer(void* buf, size_t size);
-	~RingBuffer();
-
-	void write(const sensors_event_t *ev, size_t size);
-
-private:
-	sensors_event_t *mData;
-	size_t mSize;
-	size_t mWritePos;
-	int32_t mCounter;
-
-	DISALLOW_EVIL_CONSTRUCTORS(RingBuffer);
-};
+#include "EventRingBuffer.h"
 
 class DirectChannelBase {
 public:
@@ -40,11 +27,16 @@ public:
     bool isValid();
     int getError();
     void write(const sensors_event_t * ev);
+    void write(const sensors_event_t * ev, size_t size);
+    void writeShared(const sensors_event_t * ev, size_t size);
 
 protected:
     int mError;
     RingBuffer *mBuffer;
 
+    /* Serializes sensors (data threads) writing to the same channel. */
+    android::Mutex mWriteLock;
+
     /* Internal size of ring buffer. */
     size_t mSize;
 
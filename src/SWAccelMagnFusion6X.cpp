@@ -57,7 +57,7 @@ int SWAccelMagnFusion6X::Enable(int handle, bool enable, bool lock_en_mutex)
 	bool old_status_no_handle;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	old_status = GetStatus(false);
 	old_status_no_handle = GetStatusExcludeHandle(handle);
@@ -65,7 +65,7 @@ int SWAccelMagnFusion6X::Enable(int handle, bool enable, bool lock_en_mutex)
 	err = SWSensorBaseWithPollrate::Enable(handle, enable, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
@@ -78,7 +78,7 @@ int SWAccelMagnFusion6X::Enable(int handle, bool enable, bool lock_en_mutex)
 	}
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 }
@@ -91,18 +91,18 @@ int SWAccelMagnFusion6X::SetDelay(int handle, int64_t period_ns, int64_t timeout
 		period_ns = FREQUENCY_TO_NS(CONFIG_ST_HAL_MIN_FUSION_POLLRATE);
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	err = SWSensorBaseWithPollrate::SetDelay(handle, period_ns, timeout, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_lock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 }
@@ -58,7 +58,7 @@ int SWAccelMagnGyroFusion9X::Enable(int handle, bool enable, bool lock_en_mutex)
 	bool old_status_no_handle;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	old_status = GetStatus(false);
 	old_status_no_handle = GetStatusExcludeHandle(handle);
@@ -66,7 +66,7 @@ int SWAccelMagnGyroFusion9X::Enable(int handle, bool enable, bool lock_en_mutex)
 	err = SWSensorBaseWithPollrate::Enable(handle, enable, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
@@ -82,7 +82,7 @@ int SWAccelMagnGyroFusion9X::Enable(int handle, bool enable, bool lock_en_mutex)
 	}
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 }
@@ -95,18 +95,18 @@ int SWAccelMagnGyroFusion9X::SetDelay(int handle, int64_t period_ns, int64_t tim
 		period_ns = FREQUENCY_TO_NS(CONFIG_ST_HAL_MIN_FUSION_POLLRATE);
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	err = SWSensorBaseWithPollrate::SetDelay(handle, period_ns, timeout, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 }
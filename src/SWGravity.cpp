@@ -19,7 +19,15 @@ SWGravity::SWGravity(const char *name, int handle) :
 {
 #if (CONFIG_ST_HAL_ANDROID_VERSION > ST_HAL_KITKAT_VERSION)
 	sensor_t_data.stringType = SENSOR_STRING_TYPE_GRAVITY;
+#ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+	/* fusion runs on the application processor, 200Hz is the max rate level */
+	sensor_t_data.flags |= (SENSOR_FLAG_CONTINUOUS_MODE |
+				SENSOR_FLAG_DIRECT_CHANNEL_ASHMEM |
+				(SENSOR_DIRECT_RATE_FAST <<
+				 SENSOR_FLAG_SHIFT_DIRECT_REPORT));
+#else /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 	sensor_t_data.flags |= SENSOR_FLAG_CONTINUOUS_MODE;
+#endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 
 	sensor_t_data.maxRange = ST_HAL_GRAVITY_MAX_ON_EARTH;
@@ -70,7 +70,7 @@ int SWSensorBase::Enable(int handle, bool enable, bool lock_en_mutex)
 	bool old_status, old_status_no_handle;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	old_status = GetStatus(false);
 	old_status_no_handle = GetStatusExcludeHandle(handle);
@@ -88,26 +88,27 @@ int SWSensorBase::Enable(int handle, bool enable, bool lock_en_mutex)
 
 	if (sensor_t_data.handle == handle) {
 		if (enable) {
+			android_tap.reset();
 			sensor_my_enable = android::elapsedRealtimeNano();
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
 			WriteSAIReportToPipe();
-			ALOGD("%s : SAI ENABLE Report.", GetName());
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 		} else {
+			android_tap.flush(&output_pipe);
 			sensor_my_disable = android::elapsedRealtimeNano();
 		}
 	}
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 unlock_mutex:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return err;
 }
@@ -131,6 +132,8 @@ int SWSensorBase::AddSensorDependency(SensorBase *p)
 			sensor_t_data.fifoMaxEventCount = p->GetMaxFifoLenght();
 	}
 
+	android_tap.setMaxBatchLength(sensor_t_data.fifoMaxEventCount);
+
 	p->GetSensor_tData(&dependecy_data);
 
 	if (dependency_resolution)
@@ -171,12 +174,12 @@ int SWSensorBase::FlushData(int handle, bool lock_en_mutex)
 	unsigned int i;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	if (GetStatus(false)) {
 		if (GetMinTimeout(false) > 0) {
 			for (i = 0; i < dependencies.num; i++) {
-				err = dependencies.sb[i]->FlushData(handle, true);
+				err = dependencies.sb[i]->FlushData(handle, false);
 				if (err < 0)
 					goto unlock_mutex;
 			}
@@ -186,13 +189,13 @@ int SWSensorBase::FlushData(int handle, bool lock_en_mutex)
 		goto unlock_mutex;
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 unlock_mutex:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return -EINVAL;
 }
@@ -219,7 +222,6 @@ void SWSensorBase::ProcessFlushData(int handle, int64_t timestamp)
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
 					WriteSAIReportToPipe();
-					ALOGD("%s : SAI FLUSH Report.", GetName());
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 				} else {
@@ -237,12 +239,14 @@ void SWSensorBase::ReceiveDataFromDependency(int handle, SensorBaseData *data)
 {
 	int err;
 	bool valid_data = false;
+	int64_t global_enable = sensor_global_enable.load(std::memory_order_acquire);
+	int64_t global_disable = sensor_global_disable.load(std::memory_order_acquire);
 
-	if (sensor_global_enable > sensor_global_disable) {
-		if (data->timestamp > sensor_global_enable)
+	if (global_enable > global_disable) {
+		if (data->timestamp > global_enable)
 			valid_data = true;
 	} else {
-		if ((data->timestamp > sensor_global_enable) && (data->timestamp < sensor_global_disable))
+		if ((data->timestamp > global_enable) && (data->timestamp < global_disable))
 			valid_data = true;
 	}
 
@@ -261,27 +265,49 @@ void SWSensorBase::ReceiveDataFromDependency(int handle, SensorBaseData *data)
 
 void SWSensorBase::ThreadDataTask()
 {
-	int err;
+	int err, nfds = 2;
 	unsigned int i, fifo_len;
+	SensorBaseData *samples;
+	struct pollfd pollfd_data[3];
+	int64_t armed_deadline = INT64_MAX;
 
 	if (sensor_t_data.fifoMaxEventCount > 0)
 		fifo_len = 2 * sensor_t_data.fifoMaxEventCount;
 	else
 		fifo_len = 2;
 
-	sensors_tmp_data = (SensorBaseData *)malloc(fifo_len * sizeof(SensorBaseData));
-	if (!sensors_tmp_data) {
+	/* local: a restarted thread may run while the exiting one frees it */
+	samples = (SensorBaseData *)malloc(fifo_len * sizeof(SensorBaseData));
+	if (!samples) {
 		ALOGE("%s: Failed to allocate sensor data buffer.", GetName());
 		return;
 	}
 
+	pollfd_data[0] = android_pollfd;
+	GetThreadStopPollfd(&pollfd_data[1]);
+
+	/* android output tap holds a batch if consumer timeout is longer */
+	if ((sensor_t_data.fifoMaxEventCount > 1) &&
+	    (CreateBatchTimer(&pollfd_data[2]) >= 0))
+		nfds = 3;
+
 	while (1) {
-		err = poll(&android_pollfd, 1, -1);
+		err = poll(pollfd_data, nfds, SENSOR_BASE_THREAD_POLL_TIMEOUT);
 		if (err < 0)
 			continue;
 
-		if (android_pollfd.revents & POLLIN) {
-			err = read(android_pollfd.fd, sensors_tmp_data, fifo_len * sizeof(SensorBaseData));
+		if ((err == 0) && ThreadIdleExpired(false))
+			break;
+
+		/* HAL is being closed */
+		if (pollfd_data[1].revents & POLLIN)
+			break;
+
+		if ((nfds > 2) && (pollfd_data[2].revents & POLLIN))
+			ProcessBatchTimer(pollfd_data[2].fd, &armed_deadline);
+
+		if (pollfd_data[0].revents & POLLIN) {
+			err = read(pollfd_data[0].fd, samples, fifo_len * sizeof(SensorBaseData));
 			if (err <= 0) {
 				ALOGE("%s: Failed to read data from pipe.", GetName());
 				continue;
@@ -289,14 +315,25 @@ void SWSensorBase::ThreadDataTask()
 
 			for (i = 0; i < err / sizeof(SensorBaseData); i++) {
 				pthread_mutex_lock(&sample_in_processing_mutex);
-				sample_in_processing_timestamp = sensors_tmp_data[i].timestamp;
+				sample_in_processing_timestamp = samples[i].timestamp;
 				pthread_mutex_unlock(&sample_in_processing_mutex);
 
-				this->ProcessData(&sensors_tmp_data[i]);
+				this->ProcessData(&samples[i]);
 			}
 
+#ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+			FlushDirectChannelBatch();
+#endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
+
+			if (nfds > 2)
+				ArmBatchTimer(pollfd_data[2].fd, &armed_deadline);
 		}
 	}
+
+	if (nfds > 2)
+		close(pollfd_data[2].fd);
+
+	free(samples);
 }
 
 SWSensorBaseWithPollrate::SWSensorBaseWithPollrate(const char *name, int handle, int sensor_type,
@@ -316,11 +353,13 @@ int SWSensorBaseWithPollrate::SetDelay(int handle, int64_t period_ns, int64_t ti
 {
 	int err;
 	int64_t min_pollrate_ns, min_timeout_ns;
+	int64_t old_period_ns, old_timeout;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
-	if ((sensors_pollrates[handle] == period_ns) && (sensors_timeout[handle] == timeout)) {
+	rates.get(handle, &old_period_ns, &old_timeout);
+	if ((old_period_ns == period_ns) && (old_timeout == timeout)) {
 		err = 0;
 		goto mutex_unlock;
 	}
@@ -358,9 +397,6 @@ int SWSensorBaseWithPollrate::SetDelay(int handle, int64_t period_ns, int64_t ti
 		current_min_pollrate = min_pollrate_ns;
 		current_min_timeout = min_timeout_ns;
 
-		if (handle == sensor_t_data.handle)
-			AddNewPollrate(android::elapsedRealtimeNano(), period_ns);
-
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_INFO)
 		ALOGD("\"%s\": changed pollrate to %.2fHz, timeout=%" PRIu64 "ms (sensor type: %d).",
 				sensor_t_data.name, NS_TO_FREQUENCY((float)(uint64_t)min_pollrate_ns),
@@ -368,14 +404,21 @@ int SWSensorBaseWithPollrate::SetDelay(int handle, int64_t period_ns, int64_t ti
 #endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
 	}
 
+	/*
+	 * android output is decimated from the stream, its own period must
+	 * be updated even if the minimum period (ie. direct report) did not change.
+	 */
+	if (handle == sensor_t_data.handle)
+		AddNewPollrate(android::elapsedRealtimeNano(), period_ns);
+
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 mutex_unlock:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return err;
 }
@@ -386,12 +429,12 @@ int SWSensorBaseWithPollrate::FlushData(int handle, bool lock_en_mutex)
 	unsigned int i;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	if (GetStatus(false)) {
 		if (GetMinTimeout(false) > 0) {
 			for (i = 0; i < dependencies.num; i++) {
-				err = dependencies.sb[i]->FlushData(handle, true);
+				err = dependencies.sb[i]->FlushData(handle, false);
 				if (err < 0)
 					goto unlock_mutex;
 			}
@@ -401,20 +444,19 @@ int SWSensorBaseWithPollrate::FlushData(int handle, bool lock_en_mutex)
 		goto unlock_mutex;
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 unlock_mutex:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return -EINVAL;
 }
 
 void SWSensorBaseWithPollrate::WriteDataToPipe(int64_t hw_pollrate)
 {
-	float temp;
 	int err, flush_handle;
 	bool odr_changed = false;
 	int64_t timestamp_change = 0, new_pollrate = 0, timestamp_flush;
@@ -422,26 +464,25 @@ void SWSensorBaseWithPollrate::WriteDataToPipe(int64_t hw_pollrate)
 	err = CheckLatestNewPollrate(&timestamp_change, &new_pollrate);
 	if ((err >= 0) && (sensor_event.timestamp > timestamp_change)) {
 		current_real_pollrate = new_pollrate;
+		android_tap.setPeriod(current_real_pollrate);
 		DeleteLatestNewPollrate();
 		odr_changed = true;
 	}
 
-	temp = (float)current_real_pollrate / hw_pollrate;
-	decimator = (int)(temp + (temp / 20));
-	samples_counter++;
-
-	if (decimator == 0)
-		decimator = 1;
-
-	if (((samples_counter % decimator) == 0) || odr_changed) {
-		err = write(write_pipe_fd, &sensor_event, sizeof(sensors_event_t));
-		if (err <= 0) {
-			ALOGE("%s: Failed to write sensor data to pipe. (errno: %d)", android_name, -errno);
-			samples_counter--;
+#ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+	/* direct channels are consumers on their own, not tied to android enable */
+	if (HasDirectChannel())
+		WriteDirectChannelEvent(&sensor_event, hw_pollrate);
+#endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
+
+	if (ValidDataToPush(sensor_event.timestamp) &&
+	    android_tap.decimate(sensor_event.timestamp, hw_pollrate, odr_changed)) {
+		err = android_tap.writeEvent(&output_pipe, &sensor_event);
+		if (err < 0) {
+			ALOGE("%s: Failed to write sensor data to pipe. (errno: %d)", android_name, err);
 			return;
 		}
 
-		samples_counter = 0;
 		last_data_timestamp = sensor_event.timestamp;
 
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_EXTRA_VERBOSE)
@@ -449,7 +490,7 @@ void SWSensorBaseWithPollrate::WriteDataToPipe(int64_t hw_pollrate)
 #endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
 	}
 
-	do {
+	while (sensor_event.timestamp >= flush_stack.nextTimestamp()) {
 		flush_handle = flush_stack.readLastElement(&timestamp_flush);
 		if (flush_handle >= 0) {
 			if (timestamp_flush <= sensor_event.timestamp) {
@@ -460,12 +501,12 @@ void SWSensorBaseWithPollrate::WriteDataToPipe(int64_t hw_pollrate)
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
 					WriteSAIReportToPipe();
-					ALOGD("%s : SAI FLUSH Report.", GetName());
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 				}
 			} else
 				break;
-		}
-	} while (flush_handle >= 0);
+		} else
+			break;
+	}
 }
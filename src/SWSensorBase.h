@@ -42,8 +42,6 @@ protected:
 	int trigger_write_pipe_fd, trigger_read_pipe_fd;
 	struct pollfd android_pollfd;
 
-	SensorBaseData *sensors_tmp_data;
-
 public:
 	SWSensorBase(const char *name, int handle, int sensor_type,
 			bool use_dependency_resolution, bool use_dependency_range,
@@ -63,6 +61,9 @@ public:
 	virtual void ThreadDataTask();
 
 	bool hasDataChannels() { return true; }
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+	virtual int GetThreadPriority() { return CONFIG_ST_HAL_THREAD_VIRTUAL_PRIORITY; }
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
 };
 
 
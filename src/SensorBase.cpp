@@ -16,9 +16,28 @@
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
+#include <math.h>
+#include <sched.h>
+#include <limits.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 
 #include "SensorBase.h"
 
+#if defined(CONFIG_ST_HAL_PIPE_OVERFLOW_DROP_NEWEST)
+#define ST_HAL_PIPE_OVERFLOW_POLICY		OUTPUT_PIPE_POLICY_DROP_NEWEST
+#elif defined(CONFIG_ST_HAL_PIPE_OVERFLOW_DROP_OLDEST)
+#define ST_HAL_PIPE_OVERFLOW_POLICY		OUTPUT_PIPE_POLICY_DROP_OLDEST
+#elif defined(CONFIG_ST_HAL_PIPE_OVERFLOW_COALESCE)
+#define ST_HAL_PIPE_OVERFLOW_POLICY		OUTPUT_PIPE_POLICY_COALESCE
+#else /* CONFIG_ST_HAL_PIPE_OVERFLOW_BLOCK */
+#define ST_HAL_PIPE_OVERFLOW_POLICY		OUTPUT_PIPE_POLICY_BLOCK
+#endif /* CONFIG_ST_HAL_PIPE_OVERFLOW_* */
+
+#ifndef CONFIG_ST_HAL_PIPE_STAGING_LEN
+#define CONFIG_ST_HAL_PIPE_STAGING_LEN		(0)
+#endif /* CONFIG_ST_HAL_PIPE_STAGING_LEN */
+
 #if (CONFIG_ST_HAL_ANDROID_VERSION == ST_HAL_KITKAT_VERSION)
 void atomic_init(atomic_short *atom, int num)
 {
@@ -58,6 +77,8 @@ int atomic_load(atomic_short *atom)
 }
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 
+pthread_mutex_t SensorBase::config_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 SensorBase::SensorBase(const char *name, int handle, int type)
 {
 	int i, err, pipe_fd[2];
@@ -74,10 +95,10 @@ SensorBase::SensorBase(const char *name, int handle, int type)
 	memset(&dependencies, 0, sizeof(push_data_t));
 	memset(&sensor_t_data, 0, sizeof(struct sensor_t));
 	memset(&sensor_event, 0, sizeof(sensors_event_t));
-	memset(sensors_pollrates, 0, ST_HAL_IIO_MAX_DEVICES * sizeof(int64_t));
+	memset(&change_detection, 0, sizeof(change_detection_t));
 
-	for (i = 0; i < ST_HAL_IIO_MAX_DEVICES; i++)
-		sensors_timeout[i] = INT64_MAX;
+	for (i = 0; i < SENSOR_DEPENDENCY_ID_MAX; i++)
+		dependency_handles[i] = -1;
 
 	sensor_event.version = sizeof(sensors_event_t);
 	sensor_event.sensor = handle;
@@ -90,7 +111,6 @@ SensorBase::SensorBase(const char *name, int handle, int type)
 	sensor_t_data.version = 1;
 
 	last_data_timestamp = 0;
-	enabled_sensors_mask = 0;
 	current_real_pollrate = 0;
 	sample_in_processing_timestamp = 0;
 	current_min_pollrate = 0;
@@ -99,17 +119,23 @@ SensorBase::SensorBase(const char *name, int handle, int type)
 	sensor_global_disable = 1;
 	sensor_my_enable = 0;
 	sensor_my_disable = 1;
-	decimator = 1;
-	samples_counter = 0;
 
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
-	direct_channel_handle = 0;
-	direct_channel_rate_level = 0;
+	pthread_mutex_init(&direct_channel_mutex, NULL);
+	direct_channels = nullptr;
+	direct_channel_readers = 0;
+	direct_channel_dropped = 0;
+	pthread_mutex_init(&direct_channel_grace_mutex, NULL);
+	pthread_cond_init(&direct_channel_grace_cond, NULL);
+	direct_channel_grace_wait = false;
 #endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
 	supportsSensorAdditionalInfo = false;
+	sai_report = nullptr;
+	sai_report_len = 0;
+	pthread_mutex_init(&sai_report_mutex, NULL);
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 
@@ -119,10 +145,26 @@ SensorBase::SensorBase(const char *name, int handle, int type)
 
 	write_pipe_fd = -EINVAL;
 	read_pipe_fd = -EINVAL;
+	thread_stop_fd = -EINVAL;
 
-	pthread_mutex_init(&enable_mutex, NULL);
 	pthread_mutex_init(&sample_in_processing_mutex, NULL);
 
+	pthread_mutex_init(&thread_mutex, NULL);
+	data_thread_running = false;
+	events_thread_running = false;
+	data_thread_joinable = false;
+	events_thread_joinable = false;
+#ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+	threads_needed = false;
+	threads_idle_timestamp = 0;
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
+
+	thread_stop_fd = eventfd(0, EFD_NONBLOCK);
+	if (thread_stop_fd < 0) {
+		ALOGE("%s: Failed to create threads stop event.", GetName());
+		goto invalid_the_class;
+	}
+
 	err = pipe(pipe_fd);
 	if (err < 0) {
 		ALOGE("%s: Failed to create pipe file.", GetName());
@@ -134,6 +176,17 @@ SensorBase::SensorBase(const char *name, int handle, int type)
 	write_pipe_fd = pipe_fd[1];
 	read_pipe_fd = pipe_fd[0];
 
+	err = output_pipe.init(write_pipe_fd, android_name, type);
+	if (err < 0) {
+		ALOGE("%s: Failed to initialize output pipe.", GetName());
+		goto invalid_the_class;
+	}
+
+	err = output_pipe.setPolicy(ST_HAL_PIPE_OVERFLOW_POLICY,
+				    CONFIG_ST_HAL_PIPE_STAGING_LEN);
+	if (err < 0)
+		ALOGE("%s: Failed to set output pipe overflow policy.", GetName());
+
 	return;
 
 invalid_the_class:
@@ -142,18 +195,34 @@ invalid_the_class:
 
 SensorBase::~SensorBase()
 {
+#if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
+#if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
+	free(sai_report);
+#endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
+#endif /* CONFIG_ST_HAL_ANDROID_VERSION */
+
 	close(write_pipe_fd);
 	close(read_pipe_fd);
+
+	if (thread_stop_fd >= 0)
+		close(thread_stop_fd);
 }
 
 DependencyID SensorBase::GetDependencyIDFromHandle(int handle)
 {
-	return handle_remapping_ID[handle];
+	int i;
+
+	for (i = 0; i < SENSOR_DEPENDENCY_ID_MAX; i++) {
+		if (dependency_handles[i] == handle)
+			return (DependencyID)i;
+	}
+
+	return SENSOR_DEPENDENCY_ID_0;
 }
 
 void SensorBase::SetDependencyIDOfHandle(int handle, DependencyID id)
 {
-	handle_remapping_ID[handle] = id;
+	dependency_handles[id] = handle;
 }
 
 void SensorBase::InvalidThisClass()
@@ -191,14 +260,14 @@ int SensorBase::GetFdPipeToRead()
 	return read_pipe_fd;
 }
 
-void SensorBase::SetBitEnableMask(int handle)
+int SensorBase::SetBitEnableMask(int handle)
 {
-	enabled_sensors_mask |= (1ULL << handle);
+	return enabled_sensors.set(handle);
 }
 
 void SensorBase::ResetBitEnableMask(int handle)
 {
-	enabled_sensors_mask &= ~(1ULL << handle);
+	enabled_sensors.clear(handle);
 }
 
 int SensorBase::AddNewPollrate(int64_t timestamp, int64_t pollrate)
@@ -220,13 +289,74 @@ void SensorBase::DeleteLatestNewPollrate()
 	odr_stack.removeLastElement();
 }
 
+/**
+ * SetChangeDetection() - Enable suppression of unchanged samples
+ * @abs_threshold: min absolute change of the value to report it.
+ * @rel_threshold: min change relative to latest reported value.
+ * @heartbeat_ns: max time without reporting, 0 means no heartbeat.
+ **/
+void SensorBase::SetChangeDetection(float abs_threshold, float rel_threshold,
+				    int64_t heartbeat_ns)
+{
+	change_detection.enabled = true;
+	change_detection.abs_threshold = abs_threshold;
+	change_detection.rel_threshold = rel_threshold;
+	change_detection.heartbeat_ns = heartbeat_ns;
+	change_detection.last_valid = false;
+}
+
+void SensorBase::ResetChangeDetection()
+{
+	change_detection.last_valid = false;
+}
+
+/**
+ * ChangeDetected() - Check if value changed since latest reported one
+ * @value: new value of the sensor.
+ * @timestamp: timestamp of the new value.
+ *
+ * Return value: true if value must be reported.
+ **/
+bool SensorBase::ChangeDetected(float value, int64_t timestamp)
+{
+	float threshold;
+
+	if (!change_detection.enabled)
+		return true;
+
+	/* first sample after enable is always reported */
+	if (!change_detection.last_valid)
+		goto value_changed;
+
+	if ((change_detection.heartbeat_ns > 0) &&
+	    ((timestamp - change_detection.last_timestamp) >= change_detection.heartbeat_ns))
+		goto value_changed;
+
+	threshold = change_detection.rel_threshold * fabsf(change_detection.last_value);
+	if (threshold < change_detection.abs_threshold)
+		threshold = change_detection.abs_threshold;
+
+	if (fabsf(value - change_detection.last_value) < threshold)
+		return false;
+
+value_changed:
+	change_detection.last_valid = true;
+	change_detection.last_value = value;
+	change_detection.last_timestamp = timestamp;
+
+	return true;
+}
+
 bool SensorBase::ValidDataToPush(int64_t timestamp)
 {
-	if (sensor_my_enable > sensor_my_disable) {
-		if (timestamp > sensor_my_enable)
+	int64_t my_enable = sensor_my_enable.load(std::memory_order_acquire);
+	int64_t my_disable = sensor_my_disable.load(std::memory_order_acquire);
+
+	if (my_enable > my_disable) {
+		if (timestamp > my_enable)
 			return true;
 	} else {
-		if ((timestamp > sensor_my_enable) && (timestamp < sensor_my_disable))
+		if ((timestamp > my_enable) && (timestamp < my_disable))
 			return true;
 	}
 
@@ -270,17 +400,26 @@ selftest_status SensorBase::ExecuteSelfTest()
 int SensorBase::Enable(int handle, bool enable, bool lock_en_mutex)
 {
 	int err = 0;
-	unsigned int i = 0;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	if ((handle == sensor_t_data.handle) && (enable == GetStatusOfHandle(handle)))
 		goto enable_unlock_mutex;
 
 	if ((enable && !GetStatus(false)) || (!enable && !GetStatusExcludeHandle(handle))) {
 		if (enable) {
-			SetBitEnableMask(handle);
+			err = SetBitEnableMask(handle);
+			if (err < 0)
+				goto enable_unlock_mutex;
+
+#ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+			err = StartThreads();
+			if (err < 0) {
+				ResetBitEnableMask(handle);
+				goto enable_unlock_mutex;
+			}
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
 
 			flush_stack.resetBuffer();
 		} else {
@@ -291,11 +430,14 @@ int SensorBase::Enable(int handle, bool enable, bool lock_en_mutex)
 			ResetBitEnableMask(handle);
 		}
 
-		for (i = 0; i < dependencies.num; i++) {
-			err = dependencies.sb[i]->Enable(sensor_t_data.handle, enable, true);
-			if (err < 0)
-				goto restore_enable_dependencies;
-		}
+		err = EnableDependencies(enable);
+		if (err < 0)
+			goto restore_enable_mask;
+
+#ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+		if (!enable)
+			ReleaseThreads();
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
 
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_INFO)
 		if (enable)
@@ -304,9 +446,11 @@ int SensorBase::Enable(int handle, bool enable, bool lock_en_mutex)
 			ALOGD("\"%s\": power-off (sensor type: %d).", sensor_t_data.name, sensor_t_data.type);
 #endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
 	} else {
-		if (enable)
-			SetBitEnableMask(handle);
-		else {
+		if (enable) {
+			err = SetBitEnableMask(handle);
+			if (err < 0)
+				goto enable_unlock_mutex;
+		} else {
 			err = SetDelay(handle, 0, INT64_MAX, false);
 			if (err < 0)
 				goto enable_unlock_mutex;
@@ -316,35 +460,67 @@ int SensorBase::Enable(int handle, bool enable, bool lock_en_mutex)
 	}
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
-restore_enable_dependencies:
-	while (i > 0) {
-		i--;
-		dependencies.sb[i]->Enable(sensor_t_data.handle, !enable, true);
-	}
-
-	if (enable)
+restore_enable_mask:
+	if (enable) {
 		ResetBitEnableMask(handle);
-	else
+#ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+		ReleaseThreads();
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
+	} else
 		SetBitEnableMask(handle);
 enable_unlock_mutex:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
+
+	return err;
+}
+
+/**
+ * EnableDependencies() - Propagate enable/disable to all dependencies
+ * @enable: enable or disable dependencies.
+ *
+ * Dependencies are switched one after the other by the config_mutex
+ * owner: their Enable() is never run concurrently (sensor libraries
+ * initialized at power-on are not thread-safe).
+ * On failure dependencies already switched are restored.
+ * Must be called with config_mutex held.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorBase::EnableDependencies(bool enable)
+{
+	int err;
+	unsigned int i;
+
+	for (i = 0; i < dependencies.num; i++) {
+		err = dependencies.sb[i]->Enable(sensor_t_data.handle, enable, false);
+		if (err < 0)
+			goto restore_dependencies;
+	}
+
+	return 0;
+
+restore_dependencies:
+	while (i > 0) {
+		i--;
+		dependencies.sb[i]->Enable(sensor_t_data.handle, !enable, false);
+	}
 
 	return err;
 }
 
 bool SensorBase::GetStatusExcludeHandle(int handle)
 {
-	return (enabled_sensors_mask & ~(1ULL << handle)) > 0 ? true : false;
+	return enabled_sensors.anyExcept(handle);
 }
 
 bool SensorBase::GetStatusOfHandle(int handle)
 {
-	return (enabled_sensors_mask & (1ULL << handle)) > 0 ? true : false;
+	return enabled_sensors.test(handle);
 }
 
 bool SensorBase::GetStatusOfHandle(int handle, bool lock_en_mutex)
@@ -352,12 +528,12 @@ bool SensorBase::GetStatusOfHandle(int handle, bool lock_en_mutex)
 	bool status;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
-	status = (enabled_sensors_mask & (1ULL << handle)) > 0 ? true : false;
+	status = enabled_sensors.test(handle);
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return status;
 }
@@ -367,12 +543,12 @@ bool SensorBase::GetStatus(bool lock_en_mutex)
 	bool status;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
-	status = enabled_sensors_mask > 0 ? true : false;
+	status = enabled_sensors.any();
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return status;
 }
@@ -386,38 +562,51 @@ int SensorBase::SetDelay(int handle, int64_t period_ns, int64_t timeout, bool lo
 		return -EINVAL;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
-	restore_min_timeout = sensors_timeout[handle];
-	restore_min_period_ms = sensors_pollrates[handle];
+	rates.get(handle, &restore_min_period_ms, &restore_min_timeout);
 
-	sensors_pollrates[handle] = period_ns;
-	sensors_timeout[handle] = timeout;
+	err = rates.set(handle, period_ns, timeout);
+	if (err < 0)
+		goto unlock_mutex;
 
 	for (i = 0; i < (int)dependencies.num; i++) {
-		err = dependencies.sb[i]->SetDelay(sensor_t_data.handle, GetMinPeriod(false), GetMinTimeout(false), true);
+		err = dependencies.sb[i]->SetDelay(sensor_t_data.handle, GetMinPeriod(false), GetMinTimeout(false), false);
 		if (err < 0)
 			goto restore_delay_dependencies;
 	}
 
+	if (handle == sensor_t_data.handle)
+		android_tap.setTimeout(timeout);
+
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 
 restore_delay_dependencies:
-	sensors_pollrates[handle] = restore_min_period_ms;
-	sensors_timeout[handle] = restore_min_timeout;
+	rates.set(handle, restore_min_period_ms, restore_min_timeout);
 
 	for (i--; i >= 0; i--)
-		dependencies.sb[i]->SetDelay(sensor_t_data.handle, GetMinPeriod(false), GetMinTimeout(false), true);
+		dependencies.sb[i]->SetDelay(sensor_t_data.handle, GetMinPeriod(false), GetMinTimeout(false), false);
 
+unlock_mutex:
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return err;
 }
 
+void SensorBase::DrainOutputPipe()
+{
+	output_pipe.drain();
+}
+
+void SensorBase::GetOutputPipeStats(output_pipe_stats_t *stats)
+{
+	output_pipe.getStats(stats);
+}
+
 void SensorBase::GetDepenciesTypeList(int type[SENSOR_DEPENDENCY_ID_MAX])
 {
 	memcpy(type, dependencies_type_list, SENSOR_DEPENDENCY_ID_MAX * sizeof(int));
@@ -560,61 +749,80 @@ void SensorBase::WriteFlushEventToPipe()
 	flush_event_data.type = SENSOR_TYPE_META_DATA;
 	flush_event_data.version = META_DATA_VERSION;
 
+	/* data batched by the HAL must reach android before flush complete */
+	err = android_tap.flush(&output_pipe);
+	if (err < 0)
+		ALOGE("%s: Failed to write batched sensor data to pipe. (errno: %d)", android_name, err);
+
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
 	ALOGD("\"%s\": write flush event to pipe (sensor type: %d).", GetName(), GetType());
 #endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
 
-	err = write(write_pipe_fd, &flush_event_data, sizeof(sensors_event_t));
+	err = output_pipe.writeEvents(&flush_event_data, 1);
 	if (err <= 0)
 		ALOGE("%s: Failed to write flush event data to pipe.", android_name);
 }
 
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
-void SensorBase::WriteSensorAdditionalInfoFrameToPipe(additional_info_event_t *p_sensor_additional_info_event)
+/**
+ * InitSensorAdditionalInfoReport() - Build the complete additional info report
+ *
+ * Report (BEGIN, payload frames, END) is built once at init time, every
+ * trigger only patches the timestamp and writes it with one write.
+ *
+ * Return value: number of frames of the report, negative errno on fail.
+ **/
+int SensorBase::InitSensorAdditionalInfoReport()
 {
-	int err;
-	sensors_event_t sens_info_singleframe;
+	int i, frames, serial;
+	additional_info_event_t *array_sensorAdditionalInfoPLFrames = nullptr;
 
-	memset(&sens_info_singleframe, 0, sizeof(sensors_event_t));
+	if (!supportsSensorAdditionalInfo || sai_report)
+		return 0;
 
-	sens_info_singleframe.version = sizeof(sensors_event_t);
-	sens_info_singleframe.sensor = sensor_event.sensor;
-	sens_info_singleframe.type = SENSOR_TYPE_ADDITIONAL_INFO;
-	sens_info_singleframe.additional_info = *p_sensor_additional_info_event;
-	sens_info_singleframe.timestamp = android::elapsedRealtimeNano();
+	frames = getSensorAdditionalInfoPayLoadFramesArray(&array_sensorAdditionalInfoPLFrames);
+	if (frames <= 0) {
+		free(array_sensorAdditionalInfoPLFrames);
+		return frames;
+	}
 
-#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
-	ALOGD("\"%s\": write additional sensor info event to pipe (sensor type: %d, additional info type: %d).", GetName(), GetType(), sens_info_singleframe.additional_info.type);
-#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
-	err = write(write_pipe_fd, &sens_info_singleframe, sizeof(sensors_event_t));
-	if (err <= 0)
-		ALOGE("%s: Failed to write additional sensor info event data to pipe.", android_name);
-}
+	sai_report = (sensors_event_t *)calloc((size_t)frames + 2, sizeof(sensors_event_t));
+	if (!sai_report) {
+		free(array_sensorAdditionalInfoPLFrames);
+		ALOGE("%s: Failed to allocate memory.", GetName());
+		return -ENOMEM;
+	}
 
-void SensorBase::WriteSensorAdditionalInfoFrames(additional_info_event_t array_sensorAdditionalInfoDataFrames[], size_t frames_numb)
-{
+	sai_report_len = frames + 2;
 
-	for (size_t i = 0; i < frames_numb; ++i) {
-		ALOGV("%s : Before: item #: %zu of %zu",__func__, (i+1), frames_numb);
-		SensorBase::WriteSensorAdditionalInfoFrameToPipe(&array_sensorAdditionalInfoDataFrames[i]);
-		ALOGV("%s : Frame #:(%zu) of %zu sent.", __func__, (i=1),frames_numb);
+	for (i = 0; i < (int)sai_report_len; i++) {
+		sai_report[i].version = sizeof(sensors_event_t);
+		sai_report[i].sensor = sensor_event.sensor;
+		sai_report[i].type = SENSOR_TYPE_ADDITIONAL_INFO;
 	}
 
-}
+	sai_report[0].additional_info = *SensorAdditionalInfoEvent::getBeginFrameEvent();
+	sai_report[sai_report_len - 1].additional_info = *SensorAdditionalInfoEvent::getEndFrameEvent();
 
+	/* serial counts the frames of the same type inside the report */
+	for (i = 0; i < frames; i++) {
+		sai_report[i + 1].additional_info = array_sensorAdditionalInfoPLFrames[i];
 
-void SensorBase::WriteSensorAdditionalInfoReport(additional_info_event_t array_sensorAdditionalInfoDataFrames[], size_t frames_numb)
-{
-	const additional_info_event_t *begin_additional_info = SensorAdditionalInfoEvent::getBeginFrameEvent();
+		serial = 0;
+		while ((serial < i) && (array_sensorAdditionalInfoPLFrames[i - serial - 1].type == array_sensorAdditionalInfoPLFrames[i].type))
+			serial++;
+
+		sai_report[i + 1].additional_info.serial = serial;
+	}
 
-	const additional_info_event_t *end_additional_info = SensorAdditionalInfoEvent::getEndFrameEvent();
+	free(array_sensorAdditionalInfoPLFrames);
 
-	SensorBase::WriteSensorAdditionalInfoFrameToPipe(const_cast<additional_info_event_t*>(begin_additional_info));
-	WriteSensorAdditionalInfoFrames(array_sensorAdditionalInfoDataFrames, frames_numb);
-	SensorBase::WriteSensorAdditionalInfoFrameToPipe(const_cast<additional_info_event_t*>(end_additional_info));
-	ALOGD("%s : Sensor Additional Info Report sent.", __func__);
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_INFO)
+	ALOGD("\"%s\": additional info report built: %d payload frames (sensor type: %d).", GetName(), frames, GetType());
+#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
 
+	return sai_report_len;
 }
 
 int SensorBase::getSensorAdditionalInfoPayLoadFramesArray(additional_info_event_t **array_sensorAdditionalInfoPLFrames)
@@ -634,17 +842,28 @@ int SensorBase::getSensorAdditionalInfoPayLoadFramesArray(additional_info_event_
 
 void SensorBase::WriteSAIReportToPipe()
 {
-	additional_info_event_t *array_sensorAdditionalInfoPLFrames = nullptr;
-	int frames;
-	if (supportsSensorAdditionalInfo) {
-		frames = getSensorAdditionalInfoPayLoadFramesArray(&array_sensorAdditionalInfoPLFrames);
-		if (array_sensorAdditionalInfoPLFrames) {
-			ALOGD("%s:Sending SAINFO Report.", GetName());
-			if (frames > 0)
-				WriteSensorAdditionalInfoReport(array_sensorAdditionalInfoPLFrames, frames);
-			free(array_sensorAdditionalInfoPLFrames);
-		}
-	}
+	int err;
+	unsigned int i;
+	int64_t timestamp;
+
+	if (!sai_report)
+		return;
+
+	pthread_mutex_lock(&sai_report_mutex);
+
+	timestamp = android::elapsedRealtimeNano();
+	for (i = 0; i < sai_report_len; i++)
+		sai_report[i].timestamp = timestamp;
+
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
+	ALOGD("\"%s\": write additional info report to pipe (sensor type: %d).", GetName(), GetType());
+#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+
+	err = output_pipe.writeEvents(sai_report, sai_report_len);
+	if (err <= 0)
+		ALOGE("%s: Failed to write additional sensor info report to pipe.", android_name);
+
+	pthread_mutex_unlock(&sai_report_mutex);
 }
 
 int SensorBase::UseCustomAINFOSensorPlacementPLFramesArray(
@@ -663,7 +882,7 @@ int SensorBase::UseCustomAINFOSensorPlacementPLFramesArray(
 	}
 
 	*array_sensorAdditionalInfoPLFrames = (additional_info_event_t *)calloc((size_t)frames , sizeof(additional_info_event_t));
-	if (!array_sensorAdditionalInfoPLFrames) {
+	if (!*array_sensorAdditionalInfoPLFrames) {
 		ALOGE("%s: Failed to allocate memory.", GetName());
 		return -ENOMEM;
 	}
@@ -682,9 +901,9 @@ void SensorBase::WriteDataToPipe(int64_t __attribute__((unused))hw_pollrate)
 
 	if (ValidDataToPush(sensor_event.timestamp)) {
 		if (sensor_event.timestamp > last_data_timestamp) {
-			err = write(write_pipe_fd, &sensor_event, sizeof(sensors_event_t));
+			err = output_pipe.writeEvents(&sensor_event, 1);
 			if (err <= 0) {
-				ALOGE("%s: Failed to write sensor data to pipe. (errno: %d)", android_name, -errno);
+				ALOGE("%s: Failed to write sensor data to pipe. (errno: %d)", android_name, err);
 				return;
 			}
 
@@ -709,26 +928,95 @@ void SensorBase::ProcessData(SensorBaseData *data)
 
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
-	if (data->flush_event_handle == sensor_t_data.handle) {
-		ALOGD("%s:SAINFO Report: FLUSH.", GetName());
+	if (data->flush_event_handle == sensor_t_data.handle)
 		WriteSAIReportToPipe();
-	}
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 }
 
+/**
+ * CreateBatchTimer() - Create timer of android output tap batch
+ * @pollfd_timer: pollfd of the timer polled by data thread.
+ *
+ * Timer wakes up the data thread when max report latency of events
+ * held by android output tap expires (timestamps are on boottime clock).
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorBase::CreateBatchTimer(struct pollfd *pollfd_timer)
+{
+	pollfd_timer->fd = timerfd_create(CLOCK_BOOTTIME, TFD_NONBLOCK);
+	if (pollfd_timer->fd < 0) {
+		ALOGE("%s: Failed to create batching timer.", GetName());
+		return -errno;
+	}
+
+	pollfd_timer->events = POLLIN;
+
+	return 0;
+}
+
+void SensorBase::ArmBatchTimer(int timer_fd, int64_t *armed_deadline)
+{
+	int64_t deadline;
+	struct itimerspec timer_spec;
+
+	deadline = android_tap.getBatchDeadline();
+	if (deadline == *armed_deadline)
+		return;
+
+	memset(&timer_spec, 0, sizeof(timer_spec));
+
+	/* zero it_value disarm the timer when batch is empty */
+	if (deadline < INT64_MAX) {
+		timer_spec.it_value.tv_sec = deadline / 1000000000LL;
+		timer_spec.it_value.tv_nsec = deadline % 1000000000LL;
+	}
+
+	if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer_spec, NULL) < 0) {
+		ALOGE("%s: Failed to arm batching timer.", GetName());
+		return;
+	}
+
+	*armed_deadline = deadline;
+}
+
+/**
+ * ProcessBatchTimer() - Max report latency of android batch expired
+ * @timer_fd: batch timer.
+ * @armed_deadline: deadline the timer is armed to.
+ **/
+void SensorBase::ProcessBatchTimer(int timer_fd, int64_t *armed_deadline)
+{
+	int err;
+	uint64_t expirations;
+
+	err = read(timer_fd, &expirations, sizeof(expirations));
+	if (err < 0)
+		ALOGE("%s: Failed to read batching timer.", GetName());
+
+	*armed_deadline = INT64_MAX;
+
+	err = android_tap.flush(&output_pipe);
+	if (err < 0)
+		ALOGE("%s: Failed to write batched sensor data to pipe. (errno: %d)",
+		      GetName(), err);
+}
+
 void SensorBase::ReceiveDataFromDependency(int handle, SensorBaseData *data)
 {
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_EXTRA_VERBOSE)
 	int err;
 #endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
 	bool fill_buffer = false;
+	int64_t global_enable = sensor_global_enable.load(std::memory_order_acquire);
+	int64_t global_disable = sensor_global_disable.load(std::memory_order_acquire);
 
-	if (sensor_global_enable > sensor_global_disable) {
-		if (data->timestamp > sensor_global_enable)
+	if (global_enable > global_disable) {
+		if (data->timestamp > global_enable)
 			fill_buffer = true;
 	} else {
-		if ((data->timestamp > sensor_global_enable) && (data->timestamp < sensor_global_disable))
+		if ((data->timestamp > global_enable) && (data->timestamp < global_disable))
 			fill_buffer = true;
 	}
 
@@ -752,46 +1040,296 @@ int SensorBase::GetLatestValidDataFromDependency(int dependency_id, SensorBaseDa
 
 int64_t SensorBase::GetMinTimeout(bool lock_en_mutex)
 {
-	int i;
-	int64_t min = INT64_MAX;
+	int64_t min;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
-	for (i = 0; i < ST_HAL_IIO_MAX_DEVICES; i++) {
-		if ((sensors_timeout[i] < min) && (sensors_timeout[i] < INT64_MAX))
-			min = sensors_timeout[i];
-	}
+	min = rates.getMinTimeout();
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return min;
 }
 
 int64_t SensorBase::GetMinPeriod(bool lock_en_mutex)
 {
-	int i;
-	int64_t min = INT64_MAX;
+	int64_t min;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
-	for (i = 0; i < ST_HAL_IIO_MAX_DEVICES; i++) {
-		if ((sensors_pollrates[i] < min) && (sensors_pollrates[i] > 0))
-			min = sensors_pollrates[i];
-	}
+	min = rates.getMinPeriod();
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
-	return min == INT64_MAX ? 0 : min;
+	return min;
+}
+
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+/**
+ * sensor_base_set_thread_affinity() - Bind calling thread to configured CPUs
+ * @name: sensor name used in log messages.
+ *
+ * Called by the sensor thread itself as its first action (bionic has no
+ * pthread_attr_setaffinity_np), so it never runs on other CPUs.
+ **/
+static void sensor_base_set_thread_affinity(const char *name)
+{
+	unsigned int cpu;
+	cpu_set_t cpu_set;
+	unsigned long long mask = CONFIG_ST_HAL_THREAD_CPU_AFFINITY;
+
+	if (mask == 0)
+		return;
+
+	CPU_ZERO(&cpu_set);
+
+	for (cpu = 0; (cpu < 64) && (cpu < CPU_SETSIZE); cpu++) {
+		if (mask & (1ULL << cpu))
+			CPU_SET(cpu, &cpu_set);
+	}
+
+	if (sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set) < 0)
+		ALOGW("%s: Failed to set CPU affinity of pThread (errno=%d).", name, errno);
+}
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+
+/**
+ * CreateThread() - Create data or events thread of the sensor
+ * @thread: created thread.
+ * @events: true to create events thread, false to create data thread.
+ *
+ * If real-time scheduling is not allowed thread uses default scheduling.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorBase::CreateThread(pthread_t *thread, bool events)
+{
+	int err;
+	void *(*routine)(void *);
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+	int priority;
+	size_t stack_size;
+	pthread_attr_t attr;
+	struct sched_param param;
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+
+	if (events)
+		routine = &SensorBase::ThreadEventsWork;
+	else
+		routine = &SensorBase::ThreadDataWork;
+
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+	if (events)
+		priority = CONFIG_ST_HAL_THREAD_EVENTS_PRIORITY;
+	else
+		priority = GetThreadPriority();
+
+	pthread_attr_init(&attr);
+
+	if (CONFIG_ST_HAL_THREAD_STACK_SIZE > 0) {
+		stack_size = CONFIG_ST_HAL_THREAD_STACK_SIZE * 1024;
+		if (stack_size < PTHREAD_STACK_MIN)
+			stack_size = PTHREAD_STACK_MIN;
+
+		pthread_attr_setstacksize(&attr, stack_size);
+	}
+
+	if (priority > 0) {
+		param.sched_priority = priority;
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SENSOR_BASE_THREAD_SCHED_POLICY);
+		pthread_attr_setschedparam(&attr, &param);
+	}
+
+	err = pthread_create(thread, &attr, routine, (void *)this);
+	if ((err == EPERM) && (priority > 0)) {
+		ALOGW("%s: Real-time priority not allowed, using default scheduling.",
+		      GetName());
+		pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+		err = pthread_create(thread, &attr, routine, (void *)this);
+	}
+
+	pthread_attr_destroy(&attr);
+#else /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+	err = pthread_create(thread, NULL, routine, (void *)this);
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+
+	return -err;
+}
+
+/**
+ * StartThreads() - Start data/events threads not running yet
+ *
+ * Called at open, or at power-on if threads are started lazily. A thread
+ * that exited because of the idle timeout is joined before a new one is
+ * created.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorBase::StartThreads()
+{
+	int err = 0;
+
+	pthread_mutex_lock(&thread_mutex);
+
+	if (hasDataChannels() && !data_thread_running) {
+		if (data_thread_joinable) {
+			pthread_join(data_thread, NULL);
+			data_thread_joinable = false;
+		}
+
+		err = CreateThread(&data_thread, false);
+		if (err < 0) {
+			ALOGE("%s: Failed to create data pThread.", GetName());
+			goto unlock_mutex;
+		}
+
+		data_thread_running = true;
+		data_thread_joinable = true;
+	}
+
+	if (hasEventChannels() && !events_thread_running) {
+		if (events_thread_joinable) {
+			pthread_join(events_thread, NULL);
+			events_thread_joinable = false;
+		}
+
+		err = CreateThread(&events_thread, true);
+		if (err < 0) {
+			ALOGE("%s: Failed to create events pThread.", GetName());
+			goto unlock_mutex;
+		}
+
+		events_thread_running = true;
+		events_thread_joinable = true;
+	}
+
+#ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+	threads_needed = true;
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
+
+unlock_mutex:
+	pthread_mutex_unlock(&thread_mutex);
+
+	return err;
+}
+
+/**
+ * StopThreads() - Stop data/events threads and wait for them
+ *
+ * Called at close before the sensor is deleted. Must be called without
+ * config_mutex held: events threads may take it.
+ **/
+void SensorBase::StopThreads()
+{
+	int err;
+	uint64_t stop = 1;
+	bool join_data, join_events;
+
+	pthread_mutex_lock(&thread_mutex);
+
+	join_data = data_thread_joinable;
+	join_events = events_thread_joinable;
+	data_thread_joinable = false;
+	events_thread_joinable = false;
+
+	pthread_mutex_unlock(&thread_mutex);
+
+	if (!join_data && !join_events)
+		return;
+
+	/* eventfd stays readable: every thread polling it exits */
+	err = write(thread_stop_fd, &stop, sizeof(stop));
+	if (err < 0)
+		ALOGE("%s: Failed to stop pThreads.", GetName());
+
+	/* thread_mutex not held: exiting threads may take it */
+	if (join_data)
+		pthread_join(data_thread, NULL);
+
+	if (join_events)
+		pthread_join(events_thread, NULL);
+
+	pthread_mutex_lock(&thread_mutex);
+	data_thread_running = false;
+	events_thread_running = false;
+	pthread_mutex_unlock(&thread_mutex);
+}
+
+#ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+/**
+ * ReleaseThreads() - Start idle timeout of data/events threads
+ *
+ * Called at power-off.
+ **/
+void SensorBase::ReleaseThreads()
+{
+	pthread_mutex_lock(&thread_mutex);
+
+	threads_needed = false;
+	threads_idle_timestamp = android::elapsedRealtimeNano();
+
+	pthread_mutex_unlock(&thread_mutex);
+}
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
+
+/**
+ * ThreadIdleExpired() - Check if data/events thread must exit
+ * @events: true if caller is events thread, false if data thread.
+ *
+ * Called by threads when poll() times out. If true is returned the
+ * thread is considered stopped, caller must free its buffers and exit.
+ * The thread stays joinable.
+ *
+ * Return value: true if sensor has been powered-off for the idle timeout.
+ **/
+bool SensorBase::ThreadIdleExpired(bool __attribute__((unused))events)
+{
+	bool expired = false;
+
+#if defined(CONFIG_ST_HAL_LAZY_THREADS_ENABLED) && (CONFIG_ST_HAL_THREAD_IDLE_TIMEOUT > 0)
+	pthread_mutex_lock(&thread_mutex);
+
+	if (!threads_needed &&
+	    ((android::elapsedRealtimeNano() - threads_idle_timestamp) >=
+	     (CONFIG_ST_HAL_THREAD_IDLE_TIMEOUT * 1000000000LL))) {
+		if (events)
+			events_thread_running = false;
+		else
+			data_thread_running = false;
+
+		expired = true;
+	}
+
+	pthread_mutex_unlock(&thread_mutex);
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
+
+	return expired;
+}
+
+/**
+ * GetThreadStopPollfd() - Get pollfd signaled when threads must exit
+ * @pollfd_stop: pollfd polled by data/events thread.
+ **/
+void SensorBase::GetThreadStopPollfd(struct pollfd *pollfd_stop)
+{
+	pollfd_stop->fd = thread_stop_fd;
+	pollfd_stop->events = POLLIN;
+	pollfd_stop->revents = 0;
 }
 
 void *SensorBase::ThreadDataWork(void *context)
 {
 	SensorBase *mypointer = (SensorBase *)context;
 
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+	sensor_base_set_thread_affinity(mypointer->GetName());
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+
 	mypointer->ThreadDataTask();
 
 	return mypointer;
@@ -806,6 +1344,10 @@ void *SensorBase::ThreadEventsWork(void *context)
 {
 	SensorBase *mypointer = (SensorBase *)context;
 
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+	sensor_base_set_thread_affinity(mypointer->GetName());
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+
 	mypointer->ThreadEventsTask();
 
 	return mypointer;
@@ -838,24 +1380,458 @@ bool SensorBase::hasDataChannels()
 	return false;
 }
 
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+int SensorBase::GetThreadPriority()
+{
+	return 0;
+}
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
-int SensorBase::GetChannelHandle(void)
+/**
+ * DirectChannelsReadLock() - Get channels used by the data path
+ *
+ * Data path never blocks on the channels: it announces itself as reader
+ * before loading the pointer.
+ *
+ * Return value: set of subscribed channels, nullptr if none.
+ **/
+direct_channel_set_t *SensorBase::DirectChannelsReadLock()
 {
-	return direct_channel_handle;
+	direct_channel_readers.fetch_add(1);
+
+	return direct_channels.load();
 }
 
-void SensorBase::SetChannelHandle(int dc_handle)
+/**
+ * DirectChannelsReadUnlock() - Release channels used by the data path
+ *
+ * Last reader wakes up the config path only if it is waiting for it.
+ **/
+void SensorBase::DirectChannelsReadUnlock()
+{
+	if ((direct_channel_readers.fetch_sub(1) == 1) &&
+	    direct_channel_grace_wait.load()) {
+		pthread_mutex_lock(&direct_channel_grace_mutex);
+		pthread_cond_signal(&direct_channel_grace_cond);
+		pthread_mutex_unlock(&direct_channel_grace_mutex);
+	}
+}
+
+/**
+ * PublishDirectChannels() - Set channels used by the data path
+ * @set: new set of subscribed channels, nullptr if none.
+ *
+ * When this function returns no reader is still using the previous set,
+ * so it can be safely released. Caller sleeps until the last reader of
+ * the previous set is gone.
+ **/
+void SensorBase::PublishDirectChannels(direct_channel_set_t *set)
 {
-	direct_channel_handle = dc_handle;
+	direct_channels.store(set);
+
+	pthread_mutex_lock(&direct_channel_grace_mutex);
+
+	/* readers check the flag after leaving: no wake up is lost */
+	direct_channel_grace_wait.store(true);
+	while (direct_channel_readers.load() > 0)
+		pthread_cond_wait(&direct_channel_grace_cond,
+				  &direct_channel_grace_mutex);
+	direct_channel_grace_wait.store(false);
+
+	pthread_mutex_unlock(&direct_channel_grace_mutex);
 }
 
-int SensorBase::GetChannelDatarate(void)
+/**
+ * SetDirectChannel() - Subscribe, update or remove a direct channel
+ * @channel_handle: handle of the direct channel.
+ * @channel: direct channel to write data to.
+ * @rate_level: SENSOR_DIRECT_RATE_*, SENSOR_DIRECT_RATE_STOP removes it.
+ * @shared: channel is written by other sensors too.
+ *
+ * Every channel decimates the sensor stream with its own rate, the
+ * sensor runs at the fastest rate requested by all channels.
+ *
+ * Channel is written only by the data path: events still pending on a
+ * rate change are written by the data path before the new ones.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorBase::SetDirectChannel(int channel_handle, DirectChannelBase *channel,
+				 int rate_level, bool shared)
 {
-	return direct_channel_rate_level;
+	int err = 0;
+	unsigned int i;
+	int64_t period, stream_period = INT64_MAX;
+	direct_channel_set_t *old_set, *new_set;
+	direct_channel_sub_t *sub = nullptr, *removed = nullptr;
+
+	pthread_mutex_lock(&direct_channel_mutex);
+
+	old_set = direct_channels.load();
+
+	new_set = (direct_channel_set_t *)malloc(sizeof(direct_channel_set_t));
+	if (!new_set) {
+		err = -ENOMEM;
+		goto unlock_mutex;
+	}
+
+	new_set->num = 0;
+
+	if (old_set) {
+		for (i = 0; i < old_set->num; i++) {
+			if (old_set->sub[i]->channel_handle == channel_handle)
+				removed = old_set->sub[i];
+			else
+				new_set->sub[new_set->num++] = old_set->sub[i];
+		}
+	}
+
+	if (rate_level != SENSOR_DIRECT_RATE_STOP) {
+		if (new_set->num >= SENSOR_BASE_DIRECT_CHANNEL_MAX) {
+			err = -ENOSPC;
+			goto free_new_set;
+		}
+
+		sub = new direct_channel_sub_t;
+		sub->channel_handle = channel_handle;
+		sub->rate_level = rate_level;
+		sub->timestamp_enable = android::elapsedRealtimeNano();
+		sub->channel = channel;
+		sub->period = DirectRateLevelToPeriod(rate_level);
+		sub->stream_period = 0;
+		sub->decimation = 1;
+		sub->samples_counter = 0;
+		sub->batch_len = 0;
+		sub->shared = shared;
+		sub->retired = nullptr;
+		memset(&sub->latency, 0, sizeof(direct_channel_latency_t));
+
+		new_set->sub[new_set->num++] = sub;
+	}
+
+	/* stream runs at the fastest planned period, channels decimate from it */
+	for (i = 0; i < new_set->num; i++) {
+		period = PlanDirectChannelPeriod(new_set->sub[i]->period);
+		if ((period > 0) && (period < stream_period))
+			stream_period = period;
+	}
+
+	if (stream_period == INT64_MAX)
+		stream_period = 0;
+
+	for (i = 0; i < new_set->num; i++) {
+		new_set->sub[i]->effective_period = stream_period *
+			DirectChannelDecimation(new_set->sub[i]->period, stream_period);
+	}
+
+	/* sensor must be running before data is routed to the new channel */
+	if (new_set->num > 0) {
+		err = Enable(SENSOR_BASE_DIRECT_CHANNEL_HANDLE, true, true);
+		if (err < 0)
+			goto delete_sub;
+
+		err = SetDelay(SENSOR_BASE_DIRECT_CHANNEL_HANDLE, stream_period, 0, true);
+		if (err < 0)
+			goto delete_sub;
+	}
+
+	if (new_set->num == 0) {
+		free(new_set);
+		new_set = nullptr;
+	}
+
+	/* rate change moves pending data on, stop discards it */
+	if (sub)
+		sub->retired = removed;
+
+	PublishDirectChannels(new_set);
+	free(old_set);
+
+	if (removed) {
+		/* data path is done with it, events retired before are lost */
+		if (removed->retired) {
+			direct_channel_dropped.fetch_add(removed->retired->batch_len,
+							 std::memory_order_relaxed);
+			delete removed->retired;
+			removed->retired = nullptr;
+		}
+
+		if (!sub)
+			direct_channel_dropped.fetch_add(removed->batch_len, std::memory_order_relaxed);
+
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_INFO)
+		if (removed->latency.samples > 0)
+			ALOGD("\"%s\": direct channel %d latency: avg=%" PRId64 "us max=%" PRId64 "us (%" PRIu64 " samples).",
+			      GetName(), removed->channel_handle,
+			      removed->latency.sum_ns / (int64_t)removed->latency.samples / 1000,
+			      removed->latency.max_ns / 1000, removed->latency.samples);
+#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+
+		if (!sub)
+			delete removed;
+	}
+
+	if (!new_set && old_set)
+		err = Enable(SENSOR_BASE_DIRECT_CHANNEL_HANDLE, false, true);
+
+	pthread_mutex_unlock(&direct_channel_mutex);
+
+	return err;
+
+delete_sub:
+	if (!old_set)
+		Enable(SENSOR_BASE_DIRECT_CHANNEL_HANDLE, false, true);
+	delete sub;
+free_new_set:
+	free(new_set);
+unlock_mutex:
+	pthread_mutex_unlock(&direct_channel_mutex);
+
+	return err;
+}
+
+/**
+ * SetDirectChannelShared() - Set if a channel is written by other sensors
+ * @channel_handle: handle of the direct channel.
+ * @shared: channel is written by other sensors too.
+ *
+ * Channel written by one sensor only is written without any lock. When
+ * this function returns the data path uses the new mode.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorBase::SetDirectChannelShared(int channel_handle, bool shared)
+{
+	int err = -EINVAL;
+	unsigned int i;
+	direct_channel_set_t *set;
+
+	pthread_mutex_lock(&direct_channel_mutex);
+
+	set = direct_channels.load();
+	for (i = 0; set && (i < set->num); i++) {
+		if (set->sub[i]->channel_handle != channel_handle)
+			continue;
+
+		if (set->sub[i]->shared.load() != shared) {
+			set->sub[i]->shared.store(shared);
+			/* no write in the previous mode is still running */
+			PublishDirectChannels(set);
+		}
+
+		err = 0;
+		break;
+	}
+
+	pthread_mutex_unlock(&direct_channel_mutex);
+
+	return err;
+}
+
+/**
+ * GetDirectChannelDropped() - Get number of direct channel samples lost
+ *
+ * Samples are lost only if a channel is stopped while they are queued.
+ **/
+uint64_t SensorBase::GetDirectChannelDropped()
+{
+	return direct_channel_dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * WriteDirectChannelEvents() - Write events to a channel
+ * @sub: channel subscription.
+ * @events: events to write.
+ * @len: number of events.
+ *
+ * Latency is measured from the sample timestamp (for fused sensors the
+ * timestamp of the triggering gyroscope sample) to the ring buffer write.
+ **/
+void SensorBase::WriteDirectChannelEvents(direct_channel_sub_t *sub,
+					  const sensors_event_t *events,
+					  unsigned int len)
+{
+	unsigned int i;
+	int64_t latency;
+
+	if (sub->shared.load(std::memory_order_relaxed))
+		sub->channel->writeShared(events, len);
+	else
+		sub->channel->write(events, len);
+
+	latency = android::elapsedRealtimeNano();
+	for (i = 0; i < len; i++) {
+		if ((latency - events[i].timestamp) > sub->latency.max_ns)
+			sub->latency.max_ns = latency - events[i].timestamp;
+
+		sub->latency.sum_ns += latency - events[i].timestamp;
+	}
+	sub->latency.samples += len;
+}
+
+/**
+ * WriteDirectChannelBatch() - Write pending events of a channel
+ * @sub: channel subscription.
+ **/
+void SensorBase::WriteDirectChannelBatch(direct_channel_sub_t *sub)
+{
+	if (sub->retired && (sub->retired->batch_len > 0)) {
+		WriteDirectChannelEvents(sub, sub->retired->batch,
+					 sub->retired->batch_len);
+		sub->retired->batch_len = 0;
+	}
+
+	WriteDirectChannelEvents(sub, sub->batch, sub->batch_len);
+	sub->batch_len = 0;
 }
 
-void SensorBase::SetChannelDatarate(int dc_datarate)
+bool SensorBase::HasDirectChannel()
 {
-	direct_channel_rate_level = dc_datarate;
+	return direct_channels.load(std::memory_order_relaxed) != nullptr;
+}
+
+/**
+ * WriteDirectChannelEvent() - Route event to the subscribed direct channels
+ * @event: event to write.
+ * @hw_pollrate: period of the stream feeding the channels.
+ *
+ * Events are written to the shared memory with one batched write when
+ * the batch is full or at the end of each data read (FlushDirectChannelBatch).
+ **/
+void SensorBase::WriteDirectChannelEvent(const sensors_event_t *event, int64_t hw_pollrate)
+{
+	unsigned int i;
+	direct_channel_sub_t *sub;
+	direct_channel_set_t *set;
+
+	set = DirectChannelsReadLock();
+	for (i = 0; set && (i < set->num); i++) {
+		sub = set->sub[i];
+
+		if (event->timestamp <= sub->timestamp_enable)
+			continue;
+
+		/* exact decimation, recomputed when the stream odr changes */
+		if (hw_pollrate != sub->stream_period) {
+			sub->stream_period = hw_pollrate;
+			sub->decimation = DirectChannelDecimation(sub->period, hw_pollrate);
+			sub->samples_counter = 0;
+			if (hw_pollrate > 0)
+				sub->effective_period.store(hw_pollrate * sub->decimation,
+							    std::memory_order_relaxed);
+		}
+
+		if (sub->samples_counter > 0) {
+			sub->samples_counter--;
+			continue;
+		}
+
+		sub->samples_counter = sub->decimation - 1;
+
+		memcpy(&sub->batch[sub->batch_len], event, sizeof(sensors_event_t));
+		sub->batch_len++;
+
+		if (sub->batch_len >= SENSOR_BASE_DIRECT_CHANNEL_BATCH_LEN)
+			WriteDirectChannelBatch(sub);
+	}
+
+	DirectChannelsReadUnlock();
+}
+
+void SensorBase::FlushDirectChannelBatch()
+{
+	unsigned int i;
+	direct_channel_sub_t *sub;
+	direct_channel_set_t *set;
+
+	set = DirectChannelsReadLock();
+	for (i = 0; set && (i < set->num); i++) {
+		sub = set->sub[i];
+
+		if ((sub->batch_len > 0) ||
+		    (sub->retired && (sub->retired->batch_len > 0)))
+			WriteDirectChannelBatch(sub);
+	}
+
+	DirectChannelsReadUnlock();
+}
+
+/**
+ * GetDirectChannelRate() - Get rate a channel is actually fed with
+ * @channel_handle: handle of the direct channel.
+ * @rate: effective rate in Hz.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorBase::GetDirectChannelRate(int channel_handle, float *rate)
+{
+	int err = -EINVAL;
+	unsigned int i;
+	int64_t period;
+	direct_channel_set_t *set;
+
+	pthread_mutex_lock(&direct_channel_mutex);
+
+	set = direct_channels.load();
+	for (i = 0; set && (i < set->num); i++) {
+		if (set->sub[i]->channel_handle != channel_handle)
+			continue;
+
+		period = set->sub[i]->effective_period.load(std::memory_order_relaxed);
+		*rate = (period > 0) ? NS_TO_FREQUENCY((float)period) : 0;
+		err = 0;
+		break;
+	}
+
+	pthread_mutex_unlock(&direct_channel_mutex);
+
+	return err;
+}
+
+/**
+ * DirectChannelDecimation() - Integer decimation of a stream for a channel
+ * @period: nominal period of the channel rate level.
+ * @stream_period: period of the stream feeding the channel.
+ *
+ * Return value: decimation factor (>= 1).
+ **/
+unsigned int SensorBase::DirectChannelDecimation(int64_t period, int64_t stream_period)
+{
+	return DirectChannelPlanner::decimation(period, stream_period);
+}
+
+/**
+ * PlanDirectChannelPeriod() - Get stream period to request for a channel
+ * @period: nominal period of the channel rate level.
+ *
+ * Sensors without a table of available odr run at the nominal period.
+ *
+ * Return value: period to request.
+ **/
+int64_t SensorBase::PlanDirectChannelPeriod(int64_t period)
+{
+	return period;
+}
+
+/*
+ * From Android Doc:
+ *  SENSOR_DIRECT_RATE_STOP - Sensor stopped (no event output).
+ *  SENSOR_DIRECT_RATE_NORMAL - Sensor operates at nominal rate of 50Hz.
+ *  SENSOR_DIRECT_RATE_FAST - Sensor operates at nominal rate of 200Hz.
+ *  SENSOR_DIRECT_RATE_VERY_FAST - Sensor operates at nominal rate of 800Hz.
+ */
+int64_t SensorBase::DirectRateLevelToPeriod(int rate_level)
+{
+	switch (rate_level) {
+	case SENSOR_DIRECT_RATE_NORMAL:
+		return FREQUENCY_TO_NS(50);
+	case SENSOR_DIRECT_RATE_FAST:
+		return FREQUENCY_TO_NS(200);
+	case SENSOR_DIRECT_RATE_VERY_FAST:
+		return FREQUENCY_TO_NS(800);
+	default:
+		return 0;
+	}
 }
 #endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <float.h>
 #include <stdlib.h>
+#include <poll.h>
 
 #include <hardware/sensors.h>
 #if CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_OREO_VERSION
@@ -42,12 +43,17 @@
 #include "common_data.h"
 #include <CircularBuffer.h>
 #include <FlushBufferStack.h>
-#include <FlushRequested.h>
 #include <ChangeODRTimestampStack.h>
+#include <SensorOutputPipe.h>
+#include <SensorOutputTap.h>
+#include <RateTable.h>
+#include <HandleBitmap.h>
+#include <atomic>
 
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
 #include <unordered_map>
 #include "RingBuffer.h"
+#include "DirectChannelPlanner.h"
 #endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
@@ -80,6 +86,27 @@ int atomic_load(atomic_short *counter);
 #define SENSOR_DATA_4AXIS_ACCUR		(5)
 
 #define SENSOR_BASE_ANDROID_NAME_MAX		(40)
+#define SENSOR_BASE_CACHE_LINE_SIZE		(64)
+
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+#ifdef CONFIG_ST_HAL_THREAD_SCHED_RR
+#define SENSOR_BASE_THREAD_SCHED_POLICY		SCHED_RR
+#else /* CONFIG_ST_HAL_THREAD_SCHED_RR */
+#define SENSOR_BASE_THREAD_SCHED_POLICY		SCHED_FIFO
+#endif /* CONFIG_ST_HAL_THREAD_SCHED_RR */
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
+
+/* threads wake up once per idle timeout to check if they can exit [ms] */
+#if defined(CONFIG_ST_HAL_LAZY_THREADS_ENABLED) && (CONFIG_ST_HAL_THREAD_IDLE_TIMEOUT > 0)
+#define SENSOR_BASE_THREAD_POLL_TIMEOUT		(CONFIG_ST_HAL_THREAD_IDLE_TIMEOUT * 1000)
+#else /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
+#define SENSOR_BASE_THREAD_POLL_TIMEOUT		(-1)
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
+#define SENSOR_BASE_DIRECT_CHANNEL_BATCH_LEN	(32)
+#define SENSOR_BASE_DIRECT_CHANNEL_MAX		(8)
+
+/* handle 0 is never assigned to a sensor: it is the direct report consumer */
+#define SENSOR_BASE_DIRECT_CHANNEL_HANDLE	(0)
 
 #define NS_TO_MS(x)				(x / 1E6)
 #define NS_TO_FREQUENCY(x)			(1E9 / x)
@@ -110,6 +137,49 @@ typedef struct dependencies {
 	SensorBase *sb[SENSOR_DEPENDENCY_ID_MAX];
 } dependencies_t;
 
+typedef struct change_detection {
+	bool enabled;
+	float abs_threshold;
+	float rel_threshold;
+	int64_t heartbeat_ns;
+	bool last_valid;
+	float last_value;
+	int64_t last_timestamp;
+} change_detection_t;
+
+#ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+/* latency from sample timestamp to ring buffer write */
+typedef struct direct_channel_latency {
+	uint64_t samples;
+	int64_t sum_ns;
+	int64_t max_ns;
+} direct_channel_latency_t;
+
+typedef struct direct_channel_sub {
+	int channel_handle;
+	int rate_level;
+	int64_t timestamp_enable;
+	DirectChannelBase *channel;
+	int64_t period;
+	int64_t stream_period;
+	unsigned int decimation;
+	unsigned int samples_counter;
+	std::atomic<int64_t> effective_period;
+	/* channel written by other sensors too, writes are serialized */
+	std::atomic<bool> shared;
+	/* subscription replaced by a rate change, its pending events go first */
+	struct direct_channel_sub *retired;
+	direct_channel_latency_t latency;
+	unsigned int batch_len;
+	sensors_event_t batch[SENSOR_BASE_DIRECT_CHANNEL_BATCH_LEN];
+} direct_channel_sub_t;
+
+typedef struct direct_channel_set {
+	unsigned int num;
+	direct_channel_sub_t *sub[SENSOR_BASE_DIRECT_CHANNEL_MAX];
+} direct_channel_set_t;
+#endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
+
 typedef enum InjectionModeID {
 	SENSOR_INJECTION_NONE = 0,
 	SENSOR_INJECTOR,
@@ -124,10 +194,10 @@ class SensorBase {
 private:
 	bool valid_class;
 
-	int64_t enabled_sensors_mask;
+	HandleBitmap enabled_sensors;
 
 	ChangeODRTimestampStack odr_stack;
-	DependencyID handle_remapping_ID[ST_HAL_IIO_MAX_DEVICES];
+	int dependency_handles[SENSOR_DEPENDENCY_ID_MAX];
 
 	int AddSensorToDataPush(SensorBase *t);
 	void RemoveSensorToDataPush(SensorBase *t);
@@ -135,50 +205,107 @@ private:
 	void SetDependencyIDOfHandle(int handle, DependencyID id);
 
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
-	int direct_channel_handle;
-	int direct_channel_rate_level;
+	pthread_mutex_t direct_channel_mutex;
+
+	/* subscribed channels in use by data path, published by config path */
+	std::atomic<direct_channel_set_t *> direct_channels;
+	std::atomic<unsigned int> direct_channel_readers;
+	std::atomic<uint64_t> direct_channel_dropped;
+
+	/* config path sleeps here until the data path left the old set */
+	pthread_mutex_t direct_channel_grace_mutex;
+	pthread_cond_t direct_channel_grace_cond;
+	std::atomic<bool> direct_channel_grace_wait;
+
+	direct_channel_set_t *DirectChannelsReadLock();
+	void DirectChannelsReadUnlock();
+	void PublishDirectChannels(direct_channel_set_t *set);
+	void WriteDirectChannelEvents(direct_channel_sub_t *sub,
+				      const sensors_event_t *events,
+				      unsigned int len);
+	void WriteDirectChannelBatch(direct_channel_sub_t *sub);
 #endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
 #if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
-	void WriteSensorAdditionalInfoFrames(additional_info_event_t array_sensorAdditionalInfoDataFrames[], size_t frames_numb);
+	pthread_mutex_t sai_report_mutex;
+	sensors_event_t *sai_report;
+	unsigned int sai_report_len;
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 
 protected:
-	char android_name[SENSOR_BASE_ANDROID_NAME_MAX];
+	/*
+	 * data path state: written by the thread producing sensor samples,
+	 * kept away from config path fields to avoid false sharing.
+	 */
+	alignas(SENSOR_BASE_CACHE_LINE_SIZE) sensors_event_t sensor_event;
+	int64_t current_real_pollrate;
+	int64_t last_data_timestamp;
+	change_detection_t change_detection;
+
+	pthread_mutex_t sample_in_processing_mutex;
+	int64_t sample_in_processing_timestamp;
+
+	/* written by config path, read by data path */
+	alignas(SENSOR_BASE_CACHE_LINE_SIZE) std::atomic<int64_t> sensor_global_enable;
+	std::atomic<int64_t> sensor_global_disable;
+	std::atomic<int64_t> sensor_my_enable;
+	std::atomic<int64_t> sensor_my_disable;
+
+	/* config path state */
+	alignas(SENSOR_BASE_CACHE_LINE_SIZE) char android_name[SENSOR_BASE_ANDROID_NAME_MAX];
 
 	int write_pipe_fd, read_pipe_fd;
+	SensorOutputPipe output_pipe;
 	int dependencies_type_list[SENSOR_DEPENDENCY_ID_MAX];
 
-	pthread_mutex_t sample_in_processing_mutex;
-	volatile int64_t sample_in_processing_timestamp;
-
 #if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_MARSHMALLOW_VERSION)
 	InjectionModeID injection_mode;
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 
-	int64_t current_real_pollrate;
 	int64_t current_min_pollrate;
 	int64_t current_min_timeout;
-	int64_t last_data_timestamp;
-	int64_t sensors_timeout[ST_HAL_IIO_MAX_DEVICES];
-	int64_t sensors_pollrates[ST_HAL_IIO_MAX_DEVICES];
-	volatile int64_t sensor_global_enable;
-	volatile int64_t sensor_global_disable;
-	volatile int64_t sensor_my_enable;
-	volatile int64_t sensor_my_disable;
-	uint8_t decimator;
-	uint8_t samples_counter;
+	RateTable rates;
 
 	push_data_t push_data;
 	dependencies_t dependencies;
 
-	pthread_mutex_t enable_mutex;
+	/*
+	 * configuration plane lock, shared by the whole sensors graph: taken
+	 * once by the HAL entry point, dependencies are reconfigured with it
+	 * already held and by the same thread. Never taken by data threads,
+	 * events threads take it only to auto-disable one-shot sensors.
+	 */
+	static pthread_mutex_t config_mutex;
+
+	/*
+	 * data/events threads lifecycle, protected by thread_mutex: threads
+	 * are joinable, a thread that exited by itself is joined on restart
+	 * or by StopThreads(). thread_stop_fd is polled by the threads.
+	 */
+	pthread_mutex_t thread_mutex;
+	pthread_t data_thread;
+	pthread_t events_thread;
+	bool data_thread_running;
+	bool events_thread_running;
+	bool data_thread_joinable;
+	bool events_thread_joinable;
+	int thread_stop_fd;
+#ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+	bool threads_needed;
+	int64_t threads_idle_timestamp;
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
 
 	FlushBufferStack flush_stack;
 
-	sensors_event_t sensor_event;
+	SensorOutputTap android_tap;
+#ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+	bool HasDirectChannel();
+	void WriteDirectChannelEvent(const sensors_event_t *event, int64_t hw_pollrate);
+	void FlushDirectChannelBatch();
+#endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
+
 	struct sensor_t sensor_t_data;
 
 	CircularBuffer *circular_buffer_data[SENSOR_DEPENDENCY_ID_MAX];
@@ -194,8 +321,21 @@ protected:
 	int AllocateBufferForDependencyData(DependencyID id, unsigned int max_fifo_len);
 	void DeAllocateBufferForDependencyData(DependencyID id);
 
-	void SetBitEnableMask(int handle);
+	void SetChangeDetection(float abs_threshold, float rel_threshold, int64_t heartbeat_ns);
+	void ResetChangeDetection();
+	bool ChangeDetected(float value, int64_t timestamp);
+
+	int SetBitEnableMask(int handle);
 	void ResetBitEnableMask(int handle);
+	int EnableDependencies(bool enable);
+	int CreateBatchTimer(struct pollfd *pollfd_timer);
+	void ArmBatchTimer(int timer_fd, int64_t *armed_deadline);
+	void ProcessBatchTimer(int timer_fd, int64_t *armed_deadline);
+#ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+	void ReleaseThreads();
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
+	bool ThreadIdleExpired(bool events);
+	void GetThreadStopPollfd(struct pollfd *pollfd_stop);
 
 	int AddNewPollrate(int64_t timestamp, int64_t pollrate);
 	int CheckLatestNewPollrate(int64_t *timestamp, int64_t *pollrate);
@@ -206,9 +346,7 @@ protected:
 
 	bool supportsSensorAdditionalInfo;
 
-	void WriteSensorAdditionalInfoFrameToPipe(additional_info_event_t *p_additional_info_event);
 	virtual int getSensorAdditionalInfoPayLoadFramesArray(additional_info_event_t **array_sensorAdditionalInfoPLFrames);
-	void WriteSensorAdditionalInfoReport(additional_info_event_t array_sensorAdditionalInfoDataFrames[], size_t frames);
 	void WriteSAIReportToPipe();
 	int UseCustomAINFOSensorPlacementPLFramesArray(additional_info_event_t** array_sensorAdditionalInfoPLFrames, additional_info_event_t* customAINFO_Placement_event = nullptr);
 #endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
@@ -222,6 +360,11 @@ public:
 	bool IsValidClass();
 
 	virtual int CustomInit();
+#if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
+#if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
+	int InitSensorAdditionalInfoReport();
+#endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
+#endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 
 	int GetType();
 	char* GetName();
@@ -229,6 +372,8 @@ public:
 	int GetFdPipeToRead();
 	int GetMaxFifoLenght();
 	bool GetSensor_tData(struct sensor_t *data);
+	void DrainOutputPipe();
+	void GetOutputPipeStats(output_pipe_stats_t *stats);
 	void GetDepenciesTypeList(int type[SENSOR_DEPENDENCY_ID_MAX]);
 	bool ValidDataToPush(int64_t timestamp);
 	bool GetDependencyMaxRange(int type, float *maxRange);
@@ -258,6 +403,10 @@ public:
 	virtual void ReceiveDataFromDependency(int handle, SensorBaseData *data);
 	virtual int GetLatestValidDataFromDependency(int dependency_id, SensorBaseData *data, int64_t timesync);
 
+	int CreateThread(pthread_t *thread, bool events);
+	int StartThreads();
+	void StopThreads();
+
 	static void *ThreadDataWork(void *context);
 	virtual void ThreadDataTask();
 
@@ -271,14 +420,19 @@ public:
 
 	virtual bool hasEventChannels();
 	virtual bool hasDataChannels();
+#ifdef CONFIG_ST_HAL_THREAD_POLICY_ENABLED
+	virtual int GetThreadPriority();
+#endif /* CONFIG_ST_HAL_THREAD_POLICY_ENABLED */
 
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
-	virtual int GetChannelHandle(void);
-	virtual void SetChannelHandle(int dc_handle);
-	virtual int GetChannelDatarate(void);
-	virtual void SetChannelDatarate(int dc_datarate);
-	std::unique_ptr<DirectChannelBase> mDirectChannel;
-	android::Mutex mDirectChannelLock;
+	static int64_t DirectRateLevelToPeriod(int rate_level);
+	static unsigned int DirectChannelDecimation(int64_t period, int64_t stream_period);
+	virtual int64_t PlanDirectChannelPeriod(int64_t period);
+	int SetDirectChannel(int channel_handle, DirectChannelBase *channel,
+			     int rate_level, bool shared);
+	int SetDirectChannelShared(int channel_handle, bool shared);
+	int GetDirectChannelRate(int channel_handle, float *rate);
+	uint64_t GetDirectChannelDropped();
 #endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 };
 
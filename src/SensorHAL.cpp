@@ -19,7 +19,10 @@
 #include <math.h>
 #include <pthread.h>
 #include <endian.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
 
 #include "SensorHAL.h"
 #include "Accelerometer.h"
@@ -1140,6 +1143,56 @@ static SensorBase* st_hal_create_class_sensor(STSensorHAL_iio_devices_data *data
 	return sb->IsValidClass() ? sb : NULL;
 }
 
+/*
+ * st_hal_set_hw_fifo() - Assign physical hw FIFO to hardware sensor class
+ * @hal_data: hal data.
+ * @sb: hardware sensor class with hw FIFO.
+ * @iio_sysfs_path: iio device sysfs path.
+ * @fifo_parents: parent device of each hw FIFO in hal_data->hw_fifos.
+ *
+ * iio devices of the same parent device (i.e. lsm6dsx accelerometer and
+ * gyroscope iio devices of one i2c/spi device) share the physical hw FIFO.
+ *
+ * Return value: 0 on success, negative number on fail.
+ */
+static int st_hal_set_hw_fifo(STSensorHAL_data *hal_data, HWSensorBase *sb,
+			      const char *iio_sysfs_path, char **fifo_parents)
+{
+	unsigned int i;
+	char *parent, *sep;
+	FlushCoalescer *fifo;
+
+	parent = realpath(iio_sysfs_path, NULL);
+	if (!parent)
+		return -errno;
+
+	sep = strrchr(parent, '/');
+	if (sep)
+		*sep = '\0';
+
+	for (i = 0; i < hal_data->hw_fifos_num; i++) {
+		if (strcmp(fifo_parents[i], parent) == 0) {
+			if (sb->SetHWFifo(hal_data->hw_fifos[i]) < 0)
+				break;
+
+			free(parent);
+
+			return 0;
+		}
+	}
+
+	if (hal_data->hw_fifos_num >= ST_HAL_IIO_MAX_DEVICES) {
+		free(parent);
+		return -ENOMEM;
+	}
+
+	fifo = new FlushCoalescer();
+	fifo_parents[hal_data->hw_fifos_num] = parent;
+	hal_data->hw_fifos[hal_data->hw_fifos_num++] = fifo;
+
+	return sb->SetHWFifo(fifo);
+}
+
 /*
  * st_hal_set_fullscale() - Change fullscale of iio device sensor
  * @iio_sysfs_path: iio device driver sysfs path.
@@ -1213,194 +1266,952 @@ static int st_hal_set_fullscale(char *iio_sysfs_path,
 	return 0;
 }
 
+/*
+ * st_hal_probe_phase: phases of iio device probe, used for boot timing
+ */
+enum st_hal_probe_phase {
+	ST_HAL_PROBE_PHASE_CHANNELS = 0,
+	ST_HAL_PROBE_PHASE_DISABLE,
+	ST_HAL_PROBE_PHASE_CLOCK,
+	ST_HAL_PROBE_PHASE_ODR_SCALES,
+	ST_HAL_PROBE_PHASE_FIFO,
+	ST_HAL_PROBE_PHASE_MAX,
+};
+
+static const char *st_hal_probe_phase_name[ST_HAL_PROBE_PHASE_MAX] = {
+	"channels",
+	"disable",
+	"clock",
+	"odr/scales",
+	"fifo",
+};
+
+/*
+ * st_hal_probe_job: iio device probe work item
+ * @iio_device: iio device name and number.
+ * @supported: index into ST_sensors_supported.
+ * @kernel_release: running kernel release, part of capabilities cache key.
+ * @data: probed data, valid only if err is 0.
+ * @err: probe result.
+ * @phase_time: time spent in every probe phase [ns].
+ */
+struct st_hal_probe_job {
+	const struct device_iio_type_name *iio_device;
+	unsigned int supported;
+	const char *kernel_release;
+	STSensorHAL_iio_devices_data data;
+	int err;
+	int64_t phase_time[ST_HAL_PROBE_PHASE_MAX];
+} typedef st_hal_probe_job;
+
+/*
+ * st_hal_probe_pool: jobs shared by probe threads
+ * @jobs: jobs array.
+ * @num: number of jobs.
+ * @next: next job to execute.
+ * @lock: protects next.
+ */
+struct st_hal_probe_pool {
+	st_hal_probe_job *jobs;
+	unsigned int num;
+	unsigned int next;
+	pthread_mutex_t lock;
+} typedef st_hal_probe_pool;
+
+static int64_t st_hal_get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * iio device capabilities cache: channels layout, scales and sampling
+ * frequencies do not change across boots of the same kernel. Increase
+ * ST_HAL_IIO_CACHE_VERSION every time a cached structure changes.
+ */
+#define ST_HAL_IIO_CACHE_MAGIC				(0x53544943)
+#define ST_HAL_IIO_CACHE_VERSION			(2)
+#define ST_HAL_IIO_CACHE_RELEASE_LEN			(65)
+
+/*
+ * st_hal_iio_cache_header: capabilities cache file header
+ * @magic: ST_HAL_IIO_CACHE_MAGIC.
+ * @version: ST_HAL_IIO_CACHE_VERSION.
+ * @kernel_release: kernel release the cache has been built with.
+ * @device_name: iio device name.
+ * @attributes_hash: hash of iio device sysfs attributes names.
+ * @num_channels: number of st_hal_iio_cache_channel following header.
+ * @sfa: sampling frequency available.
+ * @sa: scale factors available.
+ */
+struct st_hal_iio_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	char kernel_release[ST_HAL_IIO_CACHE_RELEASE_LEN];
+	char device_name[DEVICE_IIO_MAX_FILENAME_LEN];
+	uint32_t attributes_hash;
+	int32_t num_channels;
+	struct device_iio_sampling_freqs sfa;
+	struct device_iio_scales sa;
+} typedef st_hal_iio_cache_header;
+
+/*
+ * st_hal_iio_cache_channel: capabilities cache channel record
+ * @name: channel name, info.name pointer is not valid in the file.
+ * @info: channel information.
+ */
+struct st_hal_iio_cache_channel {
+	char name[DEVICE_IIO_MAX_FILENAME_LEN];
+	struct device_iio_info_channel info;
+} typedef st_hal_iio_cache_channel;
+
+static void st_hal_iio_cache_fill_header(st_hal_iio_cache_header *header,
+					 st_hal_probe_job *job,
+					 uint32_t attributes_hash)
+{
+	memset(header, 0, sizeof(st_hal_iio_cache_header));
+
+	header->magic = ST_HAL_IIO_CACHE_MAGIC;
+	header->version = ST_HAL_IIO_CACHE_VERSION;
+	strncpy(header->kernel_release, job->kernel_release,
+		ST_HAL_IIO_CACHE_RELEASE_LEN - 1);
+	strncpy(header->device_name, job->iio_device->name,
+		DEVICE_IIO_MAX_FILENAME_LEN - 1);
+	header->attributes_hash = attributes_hash;
+}
+
+/*
+ * st_hal_read_iio_cache() - Load iio device capabilities from cache
+ * @job: probe job, channels, sfa and sa are filled on success.
+ * @attributes_hash: hash of iio device sysfs attributes names.
+ *
+ * Cache is used only if built with same kernel and same sysfs layout
+ * and if index and format of every cached channel still match sysfs.
+ * Cache holds only the channels selected for the sensor class, they
+ * are not enabled here, see st_hal_select_scan_channels().
+ *
+ * Return value: 0 on success, negative number if cache is not usable.
+ */
+static int st_hal_read_iio_cache(st_hal_probe_job *job, uint32_t attributes_hash)
+{
+	int err, i;
+	FILE *cache_file;
+	char filename[DEVICE_IIO_MAX_FILENAME_LEN];
+	st_hal_iio_cache_header header, expected;
+	st_hal_iio_cache_channel record;
+	struct device_iio_info_channel *channels;
+	STSensorHAL_iio_devices_data *data = &job->data;
+
+	if (job->kernel_release[0] == '\0')
+		return -ENOENT;
+
+	snprintf(filename, sizeof(filename), "%s/%s.dat",
+		 ST_HAL_IIO_CACHE_DATA_PATH, job->iio_device->name);
+
+	cache_file = fopen(filename, "r");
+	if (!cache_file)
+		return -errno;
+
+	if (fread(&header, sizeof(header), 1, cache_file) != 1) {
+		fclose(cache_file);
+		return -EINVAL;
+	}
+
+	st_hal_iio_cache_fill_header(&expected, job, attributes_hash);
+
+	if ((header.magic != expected.magic) ||
+	    (header.version != expected.version) ||
+	    (header.attributes_hash != expected.attributes_hash) ||
+	    strncmp(header.kernel_release, expected.kernel_release,
+		    ST_HAL_IIO_CACHE_RELEASE_LEN) ||
+	    strncmp(header.device_name, expected.device_name,
+		    DEVICE_IIO_MAX_FILENAME_LEN) ||
+	    (header.num_channels < 0) ||
+	    (header.num_channels > HW_SENSOR_BASE_MAX_CHANNELS) ||
+	    (header.sfa.length > DEVICE_IIO_MAX_SAMP_FREQ_AVAILABLE) ||
+	    (header.sa.length > DEVICE_IIO_SCALE_AVAILABLE)) {
+		fclose(cache_file);
+		return -ESTALE;
+	}
+
+	channels = (struct device_iio_info_channel *)calloc(header.num_channels + 1,
+							    sizeof(struct device_iio_info_channel));
+	if (!channels) {
+		fclose(cache_file);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < header.num_channels; i++) {
+		if (fread(&record, sizeof(record), 1, cache_file) != 1) {
+			err = -EINVAL;
+			goto free_channels;
+		}
+
+		record.name[DEVICE_IIO_MAX_FILENAME_LEN - 1] = '\0';
+
+		memcpy(&channels[i], &record.info, sizeof(struct device_iio_info_channel));
+		channels[i].type_name = NULL;
+		channels[i].name = strdup(record.name);
+		if (!channels[i].name) {
+			err = -ENOMEM;
+			goto free_channels;
+		}
+	}
+
+	fclose(cache_file);
+	cache_file = NULL;
+
+	for (i = 0; i < header.num_channels; i++) {
+		err = device_iio_utils::check_channel(data->iio_sysfs_path,
+						      &channels[i]);
+		if (err < 0)
+			goto free_channels;
+	}
+
+	data->channels = channels;
+	data->num_channels = header.num_channels;
+	memcpy(&data->sfa, &header.sfa, sizeof(data->sfa));
+	memcpy(&data->sa, &header.sa, sizeof(data->sa));
+
+	return 0;
+
+free_channels:
+	for (i = 0; i < header.num_channels; i++)
+		free(channels[i].name);
+
+	free(channels);
+
+	if (cache_file)
+		fclose(cache_file);
+
+	return err;
+}
+
+/*
+ * st_hal_write_iio_cache() - Store iio device capabilities into cache
+ * @job: probe job with selected channels, sfa and sa read from sysfs.
+ * @attributes_hash: hash of iio device sysfs attributes names.
+ *
+ * Return value: 0 on success, negative number on fail.
+ */
+static int st_hal_write_iio_cache(st_hal_probe_job *job, uint32_t attributes_hash)
+{
+	int i, err = 0;
+	FILE *cache_file;
+	char filename[DEVICE_IIO_MAX_FILENAME_LEN];
+	char tmp_filename[DEVICE_IIO_MAX_FILENAME_LEN];
+	st_hal_iio_cache_header header;
+	st_hal_iio_cache_channel record;
+	STSensorHAL_iio_devices_data *data = &job->data;
+
+	if (job->kernel_release[0] == '\0')
+		return 0;
+
+	snprintf(filename, sizeof(filename), "%s/%s.dat",
+		 ST_HAL_IIO_CACHE_DATA_PATH, job->iio_device->name);
+	snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+
+	st_hal_iio_cache_fill_header(&header, job, attributes_hash);
+	header.num_channels = data->num_channels;
+	memcpy(&header.sfa, &data->sfa, sizeof(header.sfa));
+	memcpy(&header.sa, &data->sa, sizeof(header.sa));
+
+	cache_file = fopen(tmp_filename, "w");
+	if (!cache_file)
+		return -errno;
+
+	if (fwrite(&header, sizeof(header), 1, cache_file) != 1)
+		err = -EIO;
+
+	for (i = 0; (i < data->num_channels) && !err; i++) {
+		memset(&record, 0, sizeof(record));
+		strncpy(record.name, data->channels[i].name,
+			DEVICE_IIO_MAX_FILENAME_LEN - 1);
+		memcpy(&record.info, &data->channels[i], sizeof(record.info));
+		record.info.name = NULL;
+		record.info.type_name = NULL;
+
+		if (fwrite(&record, sizeof(record), 1, cache_file) != 1)
+			err = -EIO;
+	}
+
+	if (fclose(cache_file) && !err)
+		err = -errno;
+
+	/* readers never see a partially written cache */
+	if (!err && rename(tmp_filename, filename))
+		err = -errno;
+
+	if (err)
+		unlink(tmp_filename);
+
+	return err;
+}
+
+/*
+ * ST_sensors_data_channels: number of data channels read by sensor class,
+ * channels are consumed in scan index order (raw[0], raw[1], ...).
+ * Sensor types not listed here use all channels exposed by the driver.
+ */
+static const struct ST_sensors_data_channels {
+	int android_sensor_type;
+	int num;
+} ST_sensors_data_channels[] = {
+	{ .android_sensor_type = SENSOR_TYPE_ACCELEROMETER, .num = 3 },
+	{ .android_sensor_type = SENSOR_TYPE_MAGNETIC_FIELD, .num = 3 },
+	{ .android_sensor_type = SENSOR_TYPE_GYROSCOPE, .num = 3 },
+	{ .android_sensor_type = SENSOR_TYPE_PRESSURE, .num = 1 },
+	{ .android_sensor_type = SENSOR_TYPE_AMBIENT_TEMPERATURE, .num = 1 },
+	{ .android_sensor_type = SENSOR_TYPE_RELATIVE_HUMIDITY, .num = 1 },
+	{ .android_sensor_type = SENSOR_TYPE_STEP_COUNTER, .num = 1 },
+};
+
+/*
+ * st_hal_select_scan_channels() - Enable only channels used by sensor class
+ * @data: iio device data.
+ * @sensor_type: Android sensor type.
+ * @enable_used: write enable of used channels (not done by scan).
+ *
+ * Unused channels are disabled and removed from channels array, so
+ * scan layout and scan_size are computed from the reduced set. The
+ * timestamp channel is always kept.
+ *
+ * Return value: 0 on success, negative number on fail.
+ */
+static int st_hal_select_scan_channels(STSensorHAL_iio_devices_data *data,
+				       int sensor_type, bool enable_used)
+{
+	int i, data_channels = -1;
+
+	for (i = 0; i < ARRAY_SIZE(ST_sensors_data_channels); i++) {
+		if (ST_sensors_data_channels[i].android_sensor_type == sensor_type) {
+			data_channels = ST_sensors_data_channels[i].num;
+			break;
+		}
+	}
+
+	return device_iio_utils::select_channels(data->iio_sysfs_path,
+						 data->channels,
+						 &data->num_channels,
+						 data_channels, enable_used);
+}
+
+/*
+ * st_hal_probe_iio_device() - Read single iio device data from sysfs
+ * @job: probe job, data and timing are filled here.
+ *
+ * Return value: 0 on success, negative number on fail.
+ */
+static int st_hal_probe_iio_device(st_hal_probe_job *job)
+{
+	int err;
+	int64_t t;
+	bool needs_odr, cached;
+	uint32_t attributes_hash;
+	const char *name = job->iio_device->name;
+	const struct ST_sensors_supported *supported = &ST_sensors_supported[job->supported];
+	STSensorHAL_iio_devices_data *data = &job->data;
+
+	if (strcmp(&name[strlen(name) - strlen(ST_HAL_WAKEUP_SUFFIX_IIO)],
+		   ST_HAL_WAKEUP_SUFFIX_IIO) == 0)
+		data->wake_up_sensor = true;
+	else
+		data->wake_up_sensor = false;
+
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
+	switch (supported->android_sensor_type) {
+		case SENSOR_TYPE_SIGNIFICANT_MOTION:
+		case SENSOR_TYPE_TILT_DETECTOR:
+			ALOGD("\"%s\": IIO device found and supported.", name);
+			break;
+
+		default:
+			ALOGD("\"%s\": IIO device found and supported. Wake-up sensor: %s",
+			      name, data->wake_up_sensor ? "yes" : "no" );
+			break;
+	}
+#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+
+	err = asprintf(&data->iio_sysfs_path,
+		       "/sys/bus/iio/devices/iio:device%d",
+		       job->iio_device->num);
+	if (err < 0) {
+		ALOGE("\"%s\": failed to build device information. (errno: %d)", name, err);
+		return -ENOMEM;
+	}
+
+	data->power_consumption = supported->power_consumption;
+
+	needs_odr = (supported->android_sensor_type != SENSOR_TYPE_STEP_DETECTOR &&
+		     supported->android_sensor_type != SENSOR_TYPE_STEP_COUNTER &&
+		     supported->android_sensor_type != SENSOR_TYPE_SIGNIFICANT_MOTION &&
+		     supported->android_sensor_type != SENSOR_TYPE_TILT_DETECTOR &&
+		     supported->android_sensor_type != SENSOR_TYPE_WRIST_TILT_GESTURE &&
+		     supported->android_sensor_type != SENSOR_TYPE_WAKE_GESTURE &&
+		     supported->android_sensor_type != SENSOR_TYPE_PICK_UP_GESTURE &&
+
+#if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_NOUGAT_VERSION)
+		     supported->android_sensor_type != SENSOR_TYPE_MOTION_DETECT &&
+		     supported->android_sensor_type != SENSOR_TYPE_STATIONARY_DETECT &&
+		     supported->android_sensor_type != SENSOR_TYPE_DEVICE_ORIENTATION &&
+#endif /* CONFIG_ST_HAL_ANDROID_VERSION */
+
+		     supported->android_sensor_type != SENSOR_TYPE_GLANCE_GESTURE);
+
+	t = st_hal_get_time_ns();
+	err = device_iio_utils::get_attributes_hash(data->iio_sysfs_path,
+						    &attributes_hash);
+	if (err < 0) {
+		ALOGE("\"%s\": failed to read sysfs attributes. (errno: %d)", name, err);
+		goto st_hal_probe_free_iio_sysfs_path;
+	}
+
+	cached = (st_hal_read_iio_cache(job, attributes_hash) == 0);
+	if (!cached) {
+		err = device_iio_utils::scan_channel(data->iio_sysfs_path,
+						     &data->channels,
+						     &data->num_channels);
+		if (err < 0 && err != -ENOENT) {
+			ALOGE("\"%s\": failed to read IIO channels informations. (errno: %d)", name, err);
+			goto st_hal_probe_free_iio_sysfs_path;
+		}
+	}
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
+	else
+		ALOGD("\"%s\": capabilities loaded from cache.", name);
+#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+	job->phase_time[ST_HAL_PROBE_PHASE_CHANNELS] = st_hal_get_time_ns() - t;
+
+	t = st_hal_get_time_ns();
+	err = device_iio_utils::enable_sensor(data->iio_sysfs_path, false);
+	job->phase_time[ST_HAL_PROBE_PHASE_DISABLE] = st_hal_get_time_ns() - t;
+	if (err < 0) {
+		ALOGE("\"%s\": failed to disable sensor. (errno: %d)", name, err);
+		goto st_hal_probe_free_iio_channels;
+	}
+
+	t = st_hal_get_time_ns();
+	err = device_iio_utils::set_clock_type(data->iio_sysfs_path, (char *) "boottime");
+	job->phase_time[ST_HAL_PROBE_PHASE_CLOCK] = st_hal_get_time_ns() - t;
+	if (err < 0) {
+		ALOGE("\"%s\": failed to set boottime clock type. (errno: %d)", name, err);
+	}
+
+	t = st_hal_get_time_ns();
+	if (needs_odr && !cached) {
+		err = device_iio_utils::get_sampling_frequency_available(data->iio_sysfs_path, &data->sfa);
+		if (err < 0) {
+			ALOGE("\"%s\": unable to get sampling frequency availability. (errno: %d)", name, err);
+			goto st_hal_probe_free_iio_channels;
+		}
+
+		err = device_iio_utils::get_available_scales(data->iio_sysfs_path,
+							     &data->sa,
+							     supported->iio_sensor_type);
+		if (err < 0)  {
+			ALOGE("\"%s\": unable to get scale availability. (errno: %d)", name, err);
+			goto st_hal_probe_free_iio_channels;
+		}
+	}
+
+	/* channels not in cache keep the state of previous boot */
+	if (cached) {
+		err = device_iio_utils::sysfs_enable_channels(data->iio_sysfs_path, false);
+		if (err < 0 && err != -ENOENT) {
+			ALOGE("\"%s\": unable to disable scan channels. (errno: %d)", name, err);
+			goto st_hal_probe_free_iio_channels;
+		}
+	}
+
+	err = st_hal_select_scan_channels(data, supported->android_sensor_type, cached);
+	if (err < 0) {
+		ALOGE("\"%s\": unable to select scan channels. (errno: %d)", name, err);
+		goto st_hal_probe_free_iio_channels;
+	}
+
+	/* cache holds selected channels with scale before full scale selection */
+	if (!cached) {
+		err = st_hal_write_iio_cache(job, attributes_hash);
+		if (err < 0)
+			ALOGW("\"%s\": failed to write capabilities cache. (errno: %d)", name, err);
+	}
+
+	if (needs_odr && (data->sa.length > 0)) {
+		err = st_hal_set_fullscale(data->iio_sysfs_path, supported->android_sensor_type,
+					   &data->sa, data->channels, data->num_channels);
+		if (err < 0) {
+			ALOGE("\"%s\": unable to set full scale. (errno: %d)", name, err);
+			goto st_hal_probe_free_iio_channels;
+		}
+	}
+	job->phase_time[ST_HAL_PROBE_PHASE_ODR_SCALES] = st_hal_get_time_ns() - t;
+
+	err = asprintf(&data->device_name, "%s", name);
+	if (err < 0) {
+		ALOGE("\"%s\": asprintf %d", name, err);
+		err = -ENOMEM;
+		goto st_hal_probe_free_iio_channels;
+	}
+
+	err = asprintf(&data->android_name, "%s", supported->android_name);
+	if (err < 0) {
+		ALOGE("\"%s\": asprintf %d", supported->android_name, err);
+		err = -ENOMEM;
+		goto st_hal_probe_free_device_name;
+	}
+
+	t = st_hal_get_time_ns();
+	data->hw_fifo_len = device_iio_utils::get_hw_fifo_length(data->iio_sysfs_path);
+	job->phase_time[ST_HAL_PROBE_PHASE_FIFO] = st_hal_get_time_ns() - t;
+	if (data->hw_fifo_len <= 0)
+		data->hw_fifo_len = 1;
+
+	data->sensor_type = supported->android_sensor_type;
+	data->dev_id = job->iio_device->num;
+
+	return 0;
+
+st_hal_probe_free_device_name:
+	free(data->device_name);
+st_hal_probe_free_iio_channels:
+	free(data->channels);
+st_hal_probe_free_iio_sysfs_path:
+	free(data->iio_sysfs_path);
+
+	return err;
+}
+
+static void *st_hal_probe_thread(void *arg)
+{
+	unsigned int index;
+	st_hal_probe_pool *pool = (st_hal_probe_pool *)arg;
+
+	while (true) {
+		pthread_mutex_lock(&pool->lock);
+		index = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (index >= pool->num)
+			break;
+
+		pool->jobs[index].err = st_hal_probe_iio_device(&pool->jobs[index]);
+	}
+
+	return NULL;
+}
+
 /*
  * st_hal_load_iio_devices_data() - Read iio devices data from sysfs
  * @data: iio device data.
  *
+ * Devices are probed concurrently by up to ST_HAL_PROBE_MAX_THREADS
+ * threads, results are collected in iio device order so handles are
+ * the same of a sequential probe.
+ *
  * Return value: number of sensors found on success, negative number on fail.
  */
 static int st_hal_load_iio_devices_data(STSensorHAL_iio_devices_data *data)
 {
 	unsigned int index = 0;
 	int err;
-	unsigned int n;
-	int i, iio_devices_num;
+	unsigned int n, p;
+	int i, iio_devices_num, threads_num = 0;
+	pthread_t threads[ST_HAL_PROBE_MAX_THREADS];
 	struct device_iio_type_name iio_devices[ST_HAL_IIO_MAX_DEVICES];
+	st_hal_probe_job *jobs;
+	st_hal_probe_pool pool;
+	struct utsname kernel;
+	int64_t probe_time;
+
+	probe_time = st_hal_get_time_ns();
+
+	/* without kernel release capabilities cache is not used */
+	if (uname(&kernel) < 0)
+		kernel.release[0] = '\0';
 
 	iio_devices_num =  device_iio_utils::get_devices_name(iio_devices,
 							      ST_HAL_IIO_MAX_DEVICES);
 	if (iio_devices_num <= 0)
 		return iio_devices_num;
 
-#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
-	ALOGD("%d IIO devices available into /sys/bus/iio/devices/ folder.", iio_devices_num);
-#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
+	ALOGD("%d IIO devices available into /sys/bus/iio/devices/ folder.", iio_devices_num);
+#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+
+	jobs = (st_hal_probe_job *)calloc(iio_devices_num, sizeof(st_hal_probe_job));
+	if (!jobs)
+		return -ENOMEM;
+
+	pool.jobs = jobs;
+	pool.num = 0;
+	pool.next = 0;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	for (i = 0; i < iio_devices_num; i++) {
+		for (n = 0; n < ARRAY_SIZE(ST_sensors_supported); n++) {
+			err = strncmp(iio_devices[i].name, ST_sensors_supported[n].driver_name,
+				      strlen(ST_sensors_supported[n].driver_name));
+			if (err == 0)
+				break;
+		}
+
+		if (n == ARRAY_SIZE(ST_sensors_supported)) {
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_EXTRA_VERBOSE)
+			ALOGD("\"%s\": IIO device not supported by sensor HAL.", iio_devices[i].name);
+#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+			continue;
+		}
+
+		jobs[pool.num].iio_device = &iio_devices[i];
+		jobs[pool.num].supported = n;
+		jobs[pool.num].kernel_release = kernel.release;
+		pool.num++;
+	}
+
+	/* calling thread is a probe worker as well */
+	while ((threads_num < ST_HAL_PROBE_MAX_THREADS - 1) &&
+	       ((unsigned int)threads_num + 1 < pool.num)) {
+		err = pthread_create(&threads[threads_num], NULL,
+				     st_hal_probe_thread, &pool);
+		if (err) {
+			ALOGW("Failed to create probe thread, continue with %d.", threads_num);
+			break;
+		}
+
+		threads_num++;
+	}
+
+	st_hal_probe_thread(&pool);
+
+	for (i = 0; i < threads_num; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&pool.lock);
+
+	for (n = 0; n < pool.num; n++) {
+		if (jobs[n].err < 0)
+			continue;
+
+		memcpy(&data[index], &jobs[n].data, sizeof(STSensorHAL_iio_devices_data));
+		index++;
+	}
+
+	probe_time = st_hal_get_time_ns() - probe_time;
+
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_INFO)
+	for (n = 0; n < pool.num; n++) {
+		for (p = 0; p < ST_HAL_PROBE_PHASE_MAX; p++)
+			ALOGD("\"%s\": probe %s: %" PRIu64 "us.",
+			      jobs[n].iio_device->name, st_hal_probe_phase_name[p],
+			      (uint64_t)(jobs[n].phase_time[p] / 1000LL));
+	}
+
+	ALOGD("Probed %u IIO devices in %" PRIu64 "ms using %d threads.",
+	      pool.num, (uint64_t)NS_TO_MS((uint64_t)probe_time), threads_num + 1);
+#else /* CONFIG_ST_HAL_DEBUG_INFO */
+	(void)p;
+	(void)st_hal_probe_phase_name;
+#endif /* CONFIG_ST_HAL_DEBUG_INFO */
+
+	free(jobs);
+
+	if (index == 0)
+		ALOGE("No IIO sensors found into /sys/bus/iio/devices/ folder.");
+
+	return index;
+}
+
+/*
+ * st_hal_free_iio_devices_data() - Free iio devices data
+ * @data: iio device data.
+ * @num_devices: number of allocated devices.
+ */
+static void st_hal_free_iio_devices_data(STSensorHAL_iio_devices_data *data,
+							unsigned int num_devices)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_devices; i++) {
+		free(data[i].android_name);
+		free(data[i].device_name);
+		free(data[i].channels);
+		free(data[i].iio_sysfs_path);
+	}
+}
+
+static inline int st_hal_get_handle(STSensorHAL_data *hal_data, int handle)
+{
+	if (handle >= hal_data->last_handle)
+		return hal_data->last_handle;
+	else
+		return handle;
+}
+
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+/**
+ * st_hal_config_apply() - Apply activate/batch request to sensors graph
+ * @hal_data: hal data.
+ * @cmd: request to apply.
+ *
+ * Errors of requests nobody waits for are logged.
+ *
+ * Return value: 0 on success, negative number on fail.
+ **/
+static int st_hal_config_apply(STSensorHAL_data *hal_data, st_hal_config_cmd *cmd)
+{
+	int err;
+	SensorBase *sb = hal_data->sensor_classes[cmd->index];
+
+	switch (cmd->id) {
+	case ST_HAL_CONFIG_CMD_ACTIVATE:
+		err = sb->Enable(cmd->handle, cmd->enable, true);
+		break;
+
+	case ST_HAL_CONFIG_CMD_BATCH:
+		err = sb->SetDelay(cmd->handle, cmd->period_ns, cmd->timeout, true);
+		break;
+
+	default:
+		err = -EINVAL;
+		break;
+	}
+
+	if ((err < 0) && !cmd->result)
+		ALOGE("\"%s\": failed to apply %s request (errno: %d).",
+		      sb->GetName(), (cmd->id == ST_HAL_CONFIG_CMD_ACTIVATE) ? "activate" : "batch", err);
+
+	return err;
+}
+
+/**
+ * st_hal_config_thread() - Config worker, applies queued requests in order
+ * @arg: hal data.
+ **/
+static void *st_hal_config_thread(void *arg)
+{
+	int err;
+	st_hal_config_cmd cmd;
+	STSensorHAL_data *hal_data = (STSensorHAL_data *)arg;
+	st_hal_config_queue *queue = &hal_data->config_queue;
+
+	pthread_mutex_lock(&queue->mutex);
+
+	while (true) {
+		while ((queue->len == 0) && queue->running)
+			pthread_cond_wait(&queue->cond, &queue->mutex);
+
+		if (queue->len == 0)
+			break;
+
+		memcpy(&cmd, &queue->cmd[queue->first], sizeof(st_hal_config_cmd));
+		queue->first = (queue->first + 1) % ST_HAL_CONFIG_QUEUE_LEN;
+		queue->len--;
+		queue->busy = true;
 
-	for (i = 0; i < iio_devices_num; i++) {
-		for (n = 0; n < ARRAY_SIZE(ST_sensors_supported); n++) {
-			err = strncmp(iio_devices[i].name, ST_sensors_supported[n].driver_name,
-				      strlen(ST_sensors_supported[n].driver_name));
-			if (err == 0)
-				break;
-		}
+		/* room available for producers */
+		pthread_cond_broadcast(&queue->cond);
+		pthread_mutex_unlock(&queue->mutex);
 
-		if (n == ARRAY_SIZE(ST_sensors_supported)) {
-#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_EXTRA_VERBOSE)
-			ALOGD("\"%s\": IIO device not supported by sensor HAL.", iio_devices[i].name);
-#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
-			continue;
-		}
+		err = st_hal_config_apply(hal_data, &cmd);
 
-		if (strcmp(&iio_devices[i].name[strlen(iio_devices[i].name) -
-			   strlen(ST_HAL_WAKEUP_SUFFIX_IIO)], ST_HAL_WAKEUP_SUFFIX_IIO) == 0)
-			data[index].wake_up_sensor = true;
-		else
-			data[index].wake_up_sensor = false;
+		pthread_mutex_lock(&queue->mutex);
+		if (cmd.result)
+			*cmd.result = err;
 
-#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
-		switch (ST_sensors_supported[n].android_sensor_type) {
-			case SENSOR_TYPE_SIGNIFICANT_MOTION:
-			case SENSOR_TYPE_TILT_DETECTOR:
-				ALOGD("\"%s\": IIO device found and supported.", iio_devices[i].name);
-				break;
+		queue->applied_seq = cmd.seq;
+		queue->busy = false;
+		pthread_cond_broadcast(&queue->cond);
+	}
 
-			default:
-				ALOGD("\"%s\": IIO device found and supported. Wake-up sensor: %s",
-				      iio_devices[i].name, data[index].wake_up_sensor ? "yes" : "no" );
-				break;
-		}
-#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+	pthread_mutex_unlock(&queue->mutex);
 
-		err = asprintf(&data[index].iio_sysfs_path,
-			       "/sys/bus/iio/devices/iio:device%d",
-			       iio_devices[i].num);
-		if (err < 0) {
-			ALOGE("\"%s\": failed to build device information. (errno: %d)", iio_devices[i].name, err);
-			continue;
-		}
+	return NULL;
+}
+
+/**
+ * st_hal_config_validate() - Check activate/batch request before queuing it
+ * @hal_data: hal data.
+ * @cmd: request to check, period is clamped as done when it is applied.
+ *
+ * Requests the sensors graph would reject are rejected here, so android
+ * gets the error from the call itself. Only failures of the drivers
+ * while the request is applied are logged by the config worker.
+ *
+ * Return value: 0 if request can be queued, negative number otherwise.
+ **/
+static int st_hal_config_validate(STSensorHAL_data *hal_data, st_hal_config_cmd *cmd)
+{
+	SensorBase *sb;
+	struct sensor_t data;
 
-		data[index].power_consumption = ST_sensors_supported[n].power_consumption;
+	if ((cmd->handle < 0) || (cmd->index >= ST_HAL_IIO_MAX_DEVICES))
+		return -EINVAL;
 
-		err = device_iio_utils::scan_channel(data[index].iio_sysfs_path,
-						     &data[index].channels,
-						     &data[index].num_channels);
-		if (err < 0 && err != -ENOENT) {
-			ALOGE("\"%s\": failed to read IIO channels informations. (errno: %d)", iio_devices[i].name, err);
-			goto st_hal_load_free_iio_sysfs_path;
-		}
+	sb = hal_data->sensor_classes[cmd->index];
+	if (!sb || !sb->IsValidClass())
+		return -ENODEV;
 
-		err = device_iio_utils::enable_sensor(data[index].iio_sysfs_path, false);
-		if (err < 0) {
-			ALOGE("\"%s\": failed to disable sensor. (errno: %d)", iio_devices[i].name, err);
-			goto st_hal_load_free_iio_channels;
-		}
+	if (cmd->id != ST_HAL_CONFIG_CMD_BATCH)
+		return 0;
 
-		err = device_iio_utils::set_clock_type(data[index].iio_sysfs_path, (char *) "boottime");
-		if (err < 0) {
-			ALOGE("\"%s\": failed to set boottime clock type. (errno: %d)", iio_devices[i].name, err);
-		}
+	if ((cmd->period_ns < 0) || (cmd->timeout < 0))
+		return -EINVAL;
 
-		if (ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_STEP_DETECTOR &&
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_STEP_COUNTER &&
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_SIGNIFICANT_MOTION &&
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_TILT_DETECTOR &&
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_WRIST_TILT_GESTURE &&
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_WAKE_GESTURE &&
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_PICK_UP_GESTURE &&
+	/* batching requested on a sensor without fifo */
+	if ((cmd->timeout > 0) && (cmd->timeout < INT64_MAX) &&
+	    (sb->GetMaxFifoLenght() == 0))
+		return -EINVAL;
 
-#if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_NOUGAT_VERSION)
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_MOTION_DETECT &&
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_STATIONARY_DETECT &&
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_DEVICE_ORIENTATION &&
+	sb->GetSensor_tData(&data);
+
+	if ((cmd->period_ns > 0) && (data.minDelay > 0) &&
+	    (cmd->period_ns < (((int64_t)data.minDelay) * 1000)))
+		cmd->period_ns = ((int64_t)data.minDelay) * 1000;
+
+#if (CONFIG_ST_HAL_ANDROID_VERSION > ST_HAL_KITKAT_VERSION)
+	if ((data.maxDelay > 0) &&
+	    (cmd->period_ns > (((int64_t)data.maxDelay) * 1000)))
+		cmd->period_ns = ((int64_t)data.maxDelay) * 1000;
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 
-		    ST_sensors_supported[n].android_sensor_type != SENSOR_TYPE_GLANCE_GESTURE) {
-			err = device_iio_utils::get_sampling_frequency_available(data[index].iio_sysfs_path, &data[index].sfa);
-			if (err < 0) {
-				ALOGE("\"%s\": unable to get sampling frequency availability. (errno: %d)", iio_devices[i].name, err);
-				goto st_hal_load_free_iio_channels;
-			}
+	return 0;
+}
 
-			err = device_iio_utils::get_available_scales(data[index].iio_sysfs_path,
-								     &data[index].sa,
-								     ST_sensors_supported[n].iio_sensor_type);
-			if (err < 0)  {
-				ALOGE("\"%s\": unable to get scale availability. (errno: %d)", iio_devices[i].name, err);
-				goto st_hal_load_free_iio_channels;
-			}
+/**
+ * st_hal_config_enqueue() - Queue activate/batch request
+ * @hal_data: hal data.
+ * @cmd: request to queue.
+ *
+ * A batch request replacing the latest queued batch of the same sensor
+ * is merged with it: only latest period and timeout are meaningful.
+ * cmd->seq is set to the sequence number of the queued request.
+ *
+ * Return value: 0 on success, -ESRCH if config worker is not running
+ * (request must be applied synchronously), negative number on fail.
+ **/
+static int st_hal_config_enqueue(STSensorHAL_data *hal_data, st_hal_config_cmd *cmd)
+{
+	int err = 0;
+	st_hal_config_cmd *last;
+	st_hal_config_queue *queue = &hal_data->config_queue;
 
-			if (data[index].sa.length > 0) {
-				err = st_hal_set_fullscale(data[index].iio_sysfs_path, ST_sensors_supported[n].android_sensor_type,
-								&data[index].sa, data[index].channels, data[index].num_channels);
-				if (err < 0) {
-					ALOGE("\"%s\": unable to set full scale. (errno: %d)", iio_devices[i].name, err);
-					goto st_hal_load_free_iio_channels;
-				}
-			}
-		}
+	pthread_mutex_lock(&queue->mutex);
 
-		err = asprintf(&data[index].device_name, "%s", iio_devices[i].name);
-		if (err < 0) {
-			ALOGE("\"%s\": asprintf %d", iio_devices[i].name, err);
-			goto st_hal_load_free_iio_channels;
-		}
+	if (!queue->running) {
+		err = -ESRCH;
+		goto unlock_mutex;
+	}
 
-		err = asprintf(&data[index].android_name, "%s", ST_sensors_supported[n].android_name);
-		if (err < 0) {
-			ALOGE("\"%s\": asprintf %d", ST_sensors_supported[n].android_name, err);
-			goto st_hal_load_free_device_name;
+	if ((cmd->id == ST_HAL_CONFIG_CMD_BATCH) && (queue->len > 0)) {
+		last = &queue->cmd[(queue->first + queue->len - 1) % ST_HAL_CONFIG_QUEUE_LEN];
+		if ((last->id == ST_HAL_CONFIG_CMD_BATCH) && (last->handle == cmd->handle)) {
+			last->period_ns = cmd->period_ns;
+			last->timeout = cmd->timeout;
+			cmd->seq = last->seq;
+			goto unlock_mutex;
 		}
+	}
 
-		data[index].hw_fifo_len = device_iio_utils::get_hw_fifo_length(data[index].iio_sysfs_path);
-		if (data[index].hw_fifo_len <= 0)
-			data[index].hw_fifo_len = 1;
+	while (queue->len == ST_HAL_CONFIG_QUEUE_LEN)
+		pthread_cond_wait(&queue->cond, &queue->mutex);
 
-		data[index].sensor_type = ST_sensors_supported[n].android_sensor_type;
-		data[index].dev_id = iio_devices[i].num;
+	cmd->seq = ++queue->queued_seq;
+	memcpy(&queue->cmd[(queue->first + queue->len) % ST_HAL_CONFIG_QUEUE_LEN],
+	       cmd, sizeof(st_hal_config_cmd));
+	queue->len++;
+	pthread_cond_broadcast(&queue->cond);
 
-		index++;
+unlock_mutex:
+	pthread_mutex_unlock(&queue->mutex);
 
-		continue;
+	return err;
+}
 
-st_hal_load_free_device_name:
-	free(data[index].device_name);
-st_hal_load_free_iio_channels:
-	free(data[index].channels);
-st_hal_load_free_iio_sysfs_path:
-	free(data[index].iio_sysfs_path);
-	}
+/**
+ * st_hal_config_wait() - Wait until a queued request is applied
+ * @hal_data: hal data.
+ * @seq: sequence number of the request.
+ *
+ * Requests are applied in order: all requests queued before are applied too.
+ **/
+static void st_hal_config_wait(STSensorHAL_data *hal_data, uint64_t seq)
+{
+	st_hal_config_queue *queue = &hal_data->config_queue;
 
-	if (index == 0)
-		ALOGE("No IIO sensors found into /sys/bus/iio/devices/ folder.");
+	pthread_mutex_lock(&queue->mutex);
 
-	return index;
+	while (queue->applied_seq < seq)
+		pthread_cond_wait(&queue->cond, &queue->mutex);
+
+	pthread_mutex_unlock(&queue->mutex);
 }
 
-/*
- * st_hal_free_iio_devices_data() - Free iio devices data
- * @data: iio device data.
- * @num_devices: number of allocated devices.
- */
-static void st_hal_free_iio_devices_data(STSensorHAL_iio_devices_data *data,
-							unsigned int num_devices)
+/**
+ * st_hal_config_wait_idle() - Wait until all queued requests are applied
+ * @hal_data: hal data.
+ **/
+static void st_hal_config_wait_idle(STSensorHAL_data *hal_data)
 {
-	unsigned int i;
+	st_hal_config_queue *queue = &hal_data->config_queue;
 
-	for (i = 0; i < num_devices; i++) {
-		free(data[i].android_name);
-		free(data[i].device_name);
-		free(data[i].channels);
-		free(data[i].iio_sysfs_path);
+	pthread_mutex_lock(&queue->mutex);
+
+	while ((queue->len > 0) || queue->busy)
+		pthread_cond_wait(&queue->cond, &queue->mutex);
+
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+/**
+ * st_hal_config_start() - Start config worker
+ * @hal_data: hal data.
+ *
+ * If worker cannot be started requests are applied synchronously.
+ **/
+static void st_hal_config_start(STSensorHAL_data *hal_data)
+{
+	st_hal_config_queue *queue = &hal_data->config_queue;
+
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+	queue->first = 0;
+	queue->len = 0;
+	queue->queued_seq = 0;
+	queue->applied_seq = 0;
+	queue->busy = false;
+	queue->running = true;
+
+	if (pthread_create(&queue->thread, NULL, st_hal_config_thread, hal_data) != 0) {
+		ALOGE("Failed to create config pThread, activate/batch are synchronous.");
+		queue->running = false;
 	}
 }
 
-static inline int st_hal_get_handle(STSensorHAL_data *hal_data, int handle)
+/**
+ * st_hal_config_stop() - Apply pending requests and stop config worker
+ * @hal_data: hal data.
+ **/
+static void st_hal_config_stop(STSensorHAL_data *hal_data)
 {
-	if (handle >= hal_data->last_handle)
-		return hal_data->last_handle;
-	else
-		return handle;
+	st_hal_config_queue *queue = &hal_data->config_queue;
+
+	pthread_mutex_lock(&queue->mutex);
+
+	if (!queue->running) {
+		pthread_mutex_unlock(&queue->mutex);
+		return;
+	}
+
+	queue->running = false;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+
+	pthread_join(queue->thread, NULL);
 }
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
 
 /**
  * st_hal_dev_flush() - Flush sensor data
@@ -1415,6 +2226,12 @@ static int st_hal_dev_flush(struct sensors_poll_device_1 *dev, int handle)
 	unsigned int index;
 
 	index = st_hal_get_handle(hal_data, handle);
+
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	/* flush must see the sensor as configured by previous requests */
+	st_hal_config_wait_idle(hal_data);
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
+
 	return hal_data->sensor_classes[index]->FlushData(handle, true);
 }
 
@@ -1453,6 +2270,10 @@ static int st_hal_dev_batch(struct sensors_poll_device_1 *dev, int handle,
 {
 	STSensorHAL_data *hal_data = (STSensorHAL_data *)dev;
 	unsigned int index = st_hal_get_handle(hal_data, handle);
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	int err;
+	st_hal_config_cmd cmd;
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
 
 #if (CONFIG_ST_HAL_ANDROID_VERSION == ST_HAL_KITKAT_VERSION)
 	if (((flags & SENSORS_BATCH_DRY_RUN) || (flags & SENSORS_BATCH_WAKE_UPON_FIFO_FULL)) && (timeout > 0)) {
@@ -1465,6 +2286,24 @@ static int st_hal_dev_batch(struct sensors_poll_device_1 *dev, int handle,
 	(void)flags;
 #endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	cmd.id = ST_HAL_CONFIG_CMD_BATCH;
+	cmd.index = index;
+	cmd.handle = handle;
+	cmd.period_ns = period_ns;
+	cmd.timeout = timeout;
+	cmd.result = NULL;
+
+	err = st_hal_config_validate(hal_data, &cmd);
+	if (err < 0)
+		return err;
+
+	/* -ESRCH: config worker not running, apply synchronously */
+	err = st_hal_config_enqueue(hal_data, &cmd);
+	if (err != -ESRCH)
+		return err;
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
+
 	return hal_data->sensor_classes[index]->SetDelay(handle, period_ns, timeout, true);
 }
 
@@ -1497,6 +2336,9 @@ static int st_hal_dev_poll(struct sensors_poll_device_t *dev,
 			remaining_event -= event_read;
 			data += event_read;
 
+			/* room available in pipe: write events held on overflow */
+			hal_data->android_pollfd_sensor[i]->DrainOutputPipe();
+
 			if (remaining_event == 0)
 				return count;
 		} else
@@ -1518,11 +2360,66 @@ static int st_hal_dev_setDelay(struct sensors_poll_device_t *dev, int handle, in
 {
 	STSensorHAL_data *hal_data = (STSensorHAL_data *)dev;
 	unsigned int index;
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	int err;
+	st_hal_config_cmd cmd;
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
 
 	index = st_hal_get_handle(hal_data, handle);
+
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	cmd.id = ST_HAL_CONFIG_CMD_BATCH;
+	cmd.index = index;
+	cmd.handle = handle;
+	cmd.period_ns = ns;
+	cmd.timeout = 0;
+	cmd.result = NULL;
+
+	err = st_hal_config_validate(hal_data, &cmd);
+	if (err < 0)
+		return err;
+
+	/* -ESRCH: config worker not running, apply synchronously */
+	err = st_hal_config_enqueue(hal_data, &cmd);
+	if (err != -ESRCH)
+		return err;
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
+
 	return hal_data->sensor_classes[index]->SetDelay(handle, ns, 0, true);
 }
 
+/**
+ * st_hal_dump_output_pipe() - Dump output pipe counters of a sensor
+ * @sb: sensor class.
+ *
+ * Only pipes that overflowed at least once are reported.
+ */
+static void st_hal_dump_output_pipe(SensorBase *sb)
+{
+	output_pipe_stats_t stats;
+
+	sb->GetOutputPipeStats(&stats);
+	if ((stats.dropped + stats.coalesced + stats.delayed) == 0)
+		return;
+
+	ALOGI("\"%s\": output pipe: written=%" PRIu64 " dropped=%" PRIu64 " coalesced=%" PRIu64 " delayed=%" PRIu64 ".",
+	      sb->GetName(), stats.written, stats.dropped, stats.coalesced, stats.delayed);
+}
+
+/**
+ * st_hal_dump() - Dump HAL runtime counters
+ * @hal_data: hal data.
+ */
+static void st_hal_dump(STSensorHAL_data *hal_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < ST_HAL_IIO_MAX_DEVICES; i++) {
+		if (hal_data->sensor_classes[i])
+			st_hal_dump_output_pipe(hal_data->sensor_classes[i]);
+	}
+}
+
 /**
  * st_hal_dev_activate() - Enable or Disable sensors
  * @dev: sensors device structure.
@@ -1535,9 +2432,40 @@ static int st_hal_dev_activate(struct sensors_poll_device_t *dev, int handle, in
 {
 	STSensorHAL_data *hal_data = (STSensorHAL_data *)dev;
 	unsigned int index;
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	int err, result = 0;
+	st_hal_config_cmd cmd;
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
 
 	index = st_hal_get_handle(hal_data, handle);
 
+	if (!enabled && hal_data->sensor_classes[index])
+		st_hal_dump_output_pipe(hal_data->sensor_classes[index]);
+
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	cmd.id = ST_HAL_CONFIG_CMD_ACTIVATE;
+	cmd.index = index;
+	cmd.handle = handle;
+	cmd.enable = (bool)enabled;
+	cmd.result = &result;
+
+	err = st_hal_config_validate(hal_data, &cmd);
+	if (err < 0)
+		return err;
+
+	/* -ESRCH: config worker not running, apply synchronously */
+	err = st_hal_config_enqueue(hal_data, &cmd);
+	if (err != -ESRCH) {
+		if (err < 0)
+			return err;
+
+		/* android must know if the sensor has been switched */
+		st_hal_config_wait(hal_data, cmd.seq);
+
+		return result;
+	}
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
+
 	return  hal_data->sensor_classes[index]->Enable(handle, (bool)enabled, true);
 }
 
@@ -1552,14 +2480,35 @@ static int st_hal_dev_close(struct hw_device_t *dev)
 	unsigned int i;
 	STSensorHAL_data *hal_data = (STSensorHAL_data *)dev;
 
-	free(hal_data->data_threads);
-	free(hal_data->events_threads);
-	free(hal_data->sensor_t_list);
-	free(hal_data);
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	st_hal_config_stop(hal_data);
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
+
+	/*
+	 * threads of a sensor push data to its consumers: all of them must be
+	 * stopped before any sensor is deleted. sensor_classes is indexed by
+	 * handle.
+	 */
+	for (i = 0; i < ST_HAL_IIO_MAX_DEVICES; i++) {
+		if (hal_data->sensor_classes[i])
+			hal_data->sensor_classes[i]->StopThreads();
+	}
+
+	st_hal_dump(hal_data);
 
-	for (i = 0; i < hal_data->sensor_available; i++)
+	for (i = 0; i < ST_HAL_IIO_MAX_DEVICES; i++)
 		delete hal_data->sensor_classes[i];
 
+	for (i = 0; i < hal_data->hw_fifos_num; i++)
+		delete hal_data->hw_fifos[i];
+
+#ifdef CONFIG_ST_HAL_THREAD_MLOCK_ENABLED
+	munlockall();
+#endif /* CONFIG_ST_HAL_THREAD_MLOCK_ENABLED */
+
+	free(hal_data->sensor_t_list);
+	free(hal_data);
+
 	return 0;
 }
 
@@ -1627,6 +2576,52 @@ static void st_hal_set_default_private_data(struct st_hal_private_data *priv_dat
 #endif /* CONFIG_ST_HAL_FACTORY_CALIBRATION */
 
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+/**
+ * st_hal_direct_channel_writers() - Count sensors writing to a channel
+ * @channel_handle: handle from st_hal_add_direct_channel()
+ * @sensor_handle: sensor not to count.
+ *
+ * Must be called with mDirectChannelLock held.
+ **/
+static unsigned int st_hal_direct_channel_writers(int channel_handle,
+						  int sensor_handle)
+{
+	unsigned int writers = 0;
+
+	for (auto &it : mSensorToChannel) {
+		if ((it.first != sensor_handle) &&
+		    (it.second.find(channel_handle) != it.second.end()))
+			writers++;
+	}
+
+	return writers;
+}
+
+/**
+ * st_hal_share_direct_channel() - Set how sensors write to a channel
+ * @hal_data: Sensor HAL structure
+ * @channel_handle: handle from st_hal_add_direct_channel()
+ * @shared: channel is written by several sensors.
+ *
+ * A channel fed by one sensor is written only by its data thread without
+ * any lock, writers of a shared channel are serialized.
+ * Must be called with mDirectChannelLock held.
+ **/
+static void st_hal_share_direct_channel(STSensorHAL_data *hal_data,
+					int channel_handle, bool shared)
+{
+	unsigned int handle;
+
+	for (auto &it : mSensorToChannel) {
+		if (it.second.find(channel_handle) == it.second.end())
+			continue;
+
+		handle = st_hal_get_handle(hal_data, it.first);
+		hal_data->sensor_classes[handle]->SetDirectChannelShared(channel_handle,
+									 shared);
+	}
+}
+
 /**
  * st_hal_dev_stop_all_direct_report() - Close all sensor for a channel handle
  *
@@ -1652,6 +2647,14 @@ static int st_hal_dev_stop_all_direct_report(STSensorHAL_data *hal_data,
 		auto j = it.second.find(channel_handle);
 		if (j != it.second.end()) {
 			it.second.erase(j);
+			handle = st_hal_get_handle(hal_data, it.first);
+			hal_data->sensor_classes[handle]->SetDirectChannel(channel_handle,
+									   nullptr,
+									   SENSOR_DIRECT_RATE_STOP,
+									   false);
+			ALOGD("Stopping Direct Report CH %d Sensor Handle %d",
+			      channel_handle, handle);
+
 			if (it.second.empty())
 				sensorToStop.push_back(it.first);
 		}
@@ -1660,14 +2663,6 @@ static int st_hal_dev_stop_all_direct_report(STSensorHAL_data *hal_data,
 	if (activeSensorList != nullptr)
 		*activeSensorList = sensorToStop;
 
-	for (auto sensor_handle : sensorToStop) {
-		handle = st_hal_get_handle(hal_data, sensor_handle);
-		hal_data->sensor_classes[handle]->Enable(handle, false, true);
-		hal_data->sensor_classes[handle]->SetDelay(handle, 0, 0, true);
-		ALOGD("Stopping Direct Report CH %d Sensor Handle %d",
-		      channel_handle, handle);
-	}
-
 	return android::NO_ERROR;
 }
 
@@ -1685,10 +2680,15 @@ static int st_hal_dev_config_direct_report(struct sensors_poll_device_1 *dev,
 					   const sensors_direct_cfg_t *config)
 {
 	STSensorHAL_data *hal_data = (STSensorHAL_data *)dev;
-	int rate_level = config->rate_level;
+	int err, rate_level = config->rate_level;
+	float effective_rate = 0;
 	int64_t ns = 0LL;
-	unsigned int handle;
+	unsigned int handle, writers;
 
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	/* rate set on top of the queued activate/batch requests */
+	st_hal_config_wait_idle(hal_data);
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
 
 	/* Check if need to disable direct report on all channel. */
 	if (sensor_handle == -1 && rate_level == SENSOR_DIRECT_RATE_STOP) {
@@ -1717,6 +2717,31 @@ static int st_hal_dev_config_direct_report(struct sensors_poll_device_1 *dev,
 		return 0;
 	}
 
+	/*
+	 * There is a direct correlation from Direct rate value to sample rate of
+	 * sensor.
+	 */
+	ns = SensorBase::DirectRateLevelToPeriod(rate_level);
+	if ((ns == 0) && (rate_level != SENSOR_DIRECT_RATE_STOP))
+		ALOGW("Invalid rate level (%d)", rate_level);
+
+	/* other sensors switch to shared writes before this one starts */
+	writers = st_hal_direct_channel_writers(channel_handle, sensor_handle);
+	if ((rate_level != SENSOR_DIRECT_RATE_STOP) && (writers > 0))
+		st_hal_share_direct_channel(hal_data, channel_handle, true);
+
+	/* Every channel subscribed to the sensor gets its own decimated stream. */
+	handle = st_hal_get_handle(hal_data, sensor_handle);
+	err = hal_data->sensor_classes[handle]->SetDirectChannel(channel_handle,
+								 i->second.get(),
+								 rate_level,
+								 writers > 0);
+	if (err < 0) {
+		ALOGE("Failed to set Direct Channel %d Sensor(%d) (errno: %d)",
+		      channel_handle, sensor_handle, err);
+		return err;
+	}
+
 	auto j = mSensorToChannel.find(sensor_handle);
 	if (j == mSensorToChannel.end()) {
 		ALOGD("Adding Sensor Handle %d to Direct Channel %d",
@@ -1730,41 +2755,13 @@ static int st_hal_dev_config_direct_report(struct sensors_poll_device_1 *dev,
 	j->second.erase(channel_handle);
 	if (rate_level != SENSOR_DIRECT_RATE_STOP)
 		j->second.insert(std::make_pair(channel_handle, rate_level));
+	else if (writers == 1)
+		st_hal_share_direct_channel(hal_data, channel_handle, false);
 
-	/*
-	 * From Android Doc:
-	 *  SENSOR_DIRECT_RATE_STOP - Sensor stopped (no event output).
-	 *  SENSOR_DIRECT_RATE_NORMAL - Sensor operates at nominal rate of 50Hz.
-	 *  SENSOR_DIRECT_RATE_FAST - Sensor operates at nominal rate of 200Hz.
-	 *  SENSOR_DIRECT_RATE_VERY_FAST - Sensor operates at nominal rate of 800Hz.
-	 *
-	 * There is a direct correlation from Direct rate value to sample rate of
-	 * sensor.
-	 */
-	switch(rate_level) {
-	case SENSOR_DIRECT_RATE_NORMAL:
-		ns = FREQUENCY_TO_NS(50);
-		break;
-	case SENSOR_DIRECT_RATE_FAST:
-		ns = FREQUENCY_TO_NS(200);
-		break;
-	case SENSOR_DIRECT_RATE_VERY_FAST:
-		ns = FREQUENCY_TO_NS(800);
-		break;
-	default:
-		ALOGW("Invalid rate level (%d)", rate_level);
-		break;
-	}
-
-	/* Associate an existing Channel Report to sensor. */
-	handle = st_hal_get_handle(hal_data, sensor_handle);
-	hal_data->sensor_classes[handle]->mDirectChannel = std::move(i->second);
-	hal_data->sensor_classes[handle]->SetChannelHandle(channel_handle);
-	hal_data->sensor_classes[handle]->Enable(handle, true, true);
-	hal_data->sensor_classes[handle]->SetDelay(handle, ns, 0, true);
-	hal_data->sensor_classes[handle]->SetChannelDatarate(rate_level);
-	ALOGD("Setting Direct Channel %d Sensor(%d) %d to rate %" PRId64 " ns",
-	      channel_handle, sensor_handle, handle, ns);
+	hal_data->sensor_classes[handle]->GetDirectChannelRate(channel_handle,
+							       &effective_rate);
+	ALOGD("Setting Direct Channel %d Sensor(%d) %d to rate %" PRId64 " ns (effective %.2fHz)",
+	      channel_handle, sensor_handle, handle, ns, effective_rate);
 
 	return sensor_handle;
 }
@@ -1821,6 +2818,17 @@ static int st_hal_dev_remove_direct_channel(struct sensors_poll_device_1 *dev,
 {
 	STSensorHAL_data *hal_data = (STSensorHAL_data *)dev;
 	unsigned int handle;
+	uint64_t dropped;
+
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	st_hal_config_wait_idle(hal_data);
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
+
+	android::Mutex::Autolock autoLock(hal_data->mDirectChannelLock);
+
+	auto i = mDirectChannel.find(channel_handle);
+	if (i == mDirectChannel.end())
+		return android::BAD_VALUE;
 
 	/* Check if there are sensors enabled for Direct Report. */
 	for (auto &it : mSensorToChannel) {
@@ -1828,20 +2836,23 @@ static int st_hal_dev_remove_direct_channel(struct sensors_poll_device_1 *dev,
 		if (j != it.second.end()) {
 			it.second.erase(j);
 			handle = st_hal_get_handle(hal_data, it.first);
-			hal_data->sensor_classes[handle]->mDirectChannelLock.lock();
-			hal_data->sensor_classes[handle]->SetDelay(handle, 0ll, 0, true);
-			hal_data->sensor_classes[handle]->Enable(handle, false, true);
-			mDirectChannel.find(channel_handle)->second =
-				std::move(hal_data->sensor_classes[handle]->mDirectChannel);
-			hal_data->sensor_classes[handle]->mDirectChannelLock.unlock();
+			hal_data->sensor_classes[handle]->SetDirectChannel(channel_handle,
+									   nullptr,
+									   SENSOR_DIRECT_RATE_STOP,
+									   false);
+
+			dropped = hal_data->sensor_classes[handle]->GetDirectChannelDropped();
+			if (dropped > 0)
+				ALOGW("Direct Report Sensor Handle %d: %" PRIu64 " samples dropped by reconfiguration",
+				      handle, dropped);
+
 			ALOGD("Stopping Direct Report Sensor CH %d Handle %d",
 			      it.first, handle);
 		}
 	}
 
-	/* Remove the channel record. */
-	android::Mutex::Autolock autoLock(hal_data->mDirectChannelLock);
-	mDirectChannel.erase(channel_handle);
+	/* Remove the channel record, no sensor is still writing to it. */
+	mDirectChannel.erase(i);
 
 	return android::NO_ERROR;
 }
@@ -1878,8 +2889,6 @@ static int st_hal_open_sensors(const struct hw_module_t *module,
 	bool real_sensor_class;
 	STSensorHAL_data *hal_data;
 	int sensor_class_valid_num = 0;
-	int sensor_class_num_data = 0, j = 0;
-	int sensor_class_num_event = 0, k = 0;
 #ifdef CONFIG_ST_HAL_FACTORY_CALIBRATION
 	struct st_hal_private_data private_data;
 #endif /* CONFIG_ST_HAL_FACTORY_CALIBRATION */
@@ -1887,6 +2896,7 @@ static int st_hal_open_sensors(const struct hw_module_t *module,
 	int type_dependencies[SENSOR_DEPENDENCY_ID_MAX], type_index;
 	SensorBase *sensor_class, *temp_sensor_class[ST_HAL_IIO_MAX_DEVICES];
 	STSensorHAL_iio_devices_data iio_devices_data[ST_HAL_IIO_MAX_DEVICES];
+	char *fifo_parents[ST_HAL_IIO_MAX_DEVICES];
 	int err = -ENODEV, i, c, device_found_num, classes_available = 0, n = 0;
 
 	hal_data = (STSensorHAL_data *)malloc(sizeof(STSensorHAL_data));
@@ -1918,6 +2928,7 @@ static int st_hal_open_sensors(const struct hw_module_t *module,
 	*device = &hal_data->poll_device.common;
 
 	mkdir(ST_HAL_DATA_PATH, S_IRWXU);
+	mkdir(ST_HAL_IIO_CACHE_DATA_PATH, S_IRWXU);
 
 #ifdef CONFIG_ST_HAL_FACTORY_CALIBRATION
 	err = st_hal_read_private_data(&private_data);
@@ -1945,6 +2956,14 @@ static int st_hal_open_sensors(const struct hw_module_t *module,
 			continue;
 		}
 
+		/* hw_fifo_len is 1 if the device has no hw FIFO */
+		if (iio_devices_data[i].hw_fifo_len > 1) {
+			err = st_hal_set_hw_fifo(hal_data, (HWSensorBase *)sensor_class,
+						 iio_devices_data[i].iio_sysfs_path, fifo_parents);
+			if (err < 0)
+				ALOGE("\"%s\": failed to set hw FIFO, flush does not wait for FIFO data.", sensor_class->GetName());
+		}
+
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
 	ALOGD("\"%s\": created HW class instance, handle: %d (sensor type: %d).", sensor_class->GetName(), sensor_class->GetHandle(), sensor_class->GetType());
 #endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
@@ -1952,15 +2971,12 @@ static int st_hal_open_sensors(const struct hw_module_t *module,
 		temp_sensor_class[classes_available] = sensor_class;
 		sensor_class_valid[classes_available] = true;
 		sensor_class_valid_num++;
-		if (sensor_class->hasDataChannels())
-			sensor_class_num_data++;
-
-		if (sensor_class->hasEventChannels())
-			sensor_class_num_event++;
-
 		classes_available++;
 	}
 
+	for (i = 0; i < (int)hal_data->hw_fifos_num; i++)
+		free(fifo_parents[i]);
+
 #ifdef CONFIG_ST_HAL_FACTORY_CALIBRATION
 	err = st_hal_write_private_data(&private_data);
 	if (err < 0)
@@ -1982,12 +2998,6 @@ static int st_hal_open_sensors(const struct hw_module_t *module,
 		temp_sensor_class[classes_available] = sensor_class;
 		sensor_class_valid[classes_available] = true;
 		sensor_class_valid_num++;
-		if (sensor_class->hasDataChannels())
-			sensor_class_num_data++;
-
-		if (sensor_class->hasEventChannels())
-			sensor_class_num_event++;
-
 		classes_available++;
 	}
 
@@ -2034,6 +3044,13 @@ failed_to_add_dependency:
 	for (i = 0; i < classes_available; i++) {
 		if (sensor_class_valid[i]) {
 			err = temp_sensor_class[i]->CustomInit();
+#if (CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_PIE_VERSION)
+#if (CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED)
+			/* sensor is still usable without additional info report */
+			if (err >= 0)
+				temp_sensor_class[i]->InitSensorAdditionalInfoReport();
+#endif /* CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED */
+#endif /* CONFIG_ST_HAL_ANDROID_VERSION */
 			if (err < 0) {
 				sensor_class_valid_num--;
 				sensor_class_valid[i] = false;
@@ -2048,39 +3065,21 @@ failed_to_add_dependency:
 		goto destroy_classes;
 	}
 
-	hal_data->data_threads = (pthread_t *)malloc(sensor_class_num_data * sizeof(pthread_t *));
-	if (!hal_data->data_threads) {
-		err = -ENOMEM;
-		goto free_sensor_t_list;
-	}
-
-	hal_data->events_threads = (pthread_t *)malloc(sensor_class_num_event * sizeof(pthread_t *));
-	if (!hal_data->events_threads) {
-		err = -ENOMEM;
-		goto free_data_threads;
-	}
+#ifdef CONFIG_ST_HAL_THREAD_MLOCK_ENABLED
+	/* stacks and buffers of sensor threads are locked and prefaulted */
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+		ALOGW("Failed to lock HAL memory (errno=%d).", errno);
+#endif /* CONFIG_ST_HAL_THREAD_MLOCK_ENABLED */
 
 	for (i = 0; i < classes_available; i++) {
 		if (sensor_class_valid[i]) {
-			if (temp_sensor_class[i]->hasDataChannels()) {
-				err = pthread_create(&hal_data->data_threads[j], NULL, &SensorBase::ThreadDataWork, (void *)temp_sensor_class[i]);
-				if (err < 0) {
-					ALOGE("%s: Failed to create IIO data pThread.", temp_sensor_class[i]->GetName());
-					sensor_class_valid[i] = false;
-					continue;
-				}
-				j++;
-			}
-
-			if (temp_sensor_class[i]->hasEventChannels()) {
-				err = pthread_create(&hal_data->events_threads[k], NULL, &SensorBase::ThreadEventsWork, (void *)temp_sensor_class[i]);
-				if (err < 0) {
-					ALOGE("%s: Failed to create IIO events pThread.", temp_sensor_class[i]->GetName());
-					sensor_class_valid[i] = false;
-					continue;
-				}
-				k++;
+#ifndef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+			err = temp_sensor_class[i]->StartThreads();
+			if (err < 0) {
+				sensor_class_valid[i] = false;
+				continue;
 			}
+#endif /* CONFIG_ST_HAL_LAZY_THREADS_ENABLED */
 
 			real_sensor_class = hal_data->sensor_classes[temp_sensor_class[i]->GetHandle()]->GetSensor_tData(&hal_data->sensor_t_list[n]);
 			if (!real_sensor_class)
@@ -2088,6 +3087,7 @@ failed_to_add_dependency:
 
 			hal_data->android_pollfd[n].events = POLLIN;
 			hal_data->android_pollfd[n].fd = hal_data->sensor_classes[temp_sensor_class[i]->GetHandle()]->GetFdPipeToRead();
+			hal_data->android_pollfd_sensor[n] = hal_data->sensor_classes[temp_sensor_class[i]->GetHandle()];
 
 			hal_data->last_handle = temp_sensor_class[i]->GetHandle();
 			n++;
@@ -2121,16 +3121,24 @@ failed_to_add_dependency:
 	hal_data->mDirectChannelHandle = 1;
 #endif /* CONFIG_ST_HAL_DIRECT_REPORT_SENSOR */
 
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	st_hal_config_start(hal_data);
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
+
 	return 0;
 
-free_data_threads:
-	free(hal_data->data_threads);
 free_sensor_t_list:
 	free(hal_data->sensor_t_list);
 destroy_classes:
+	for (i = 0; i < classes_available; i ++)
+		temp_sensor_class[i]->StopThreads();
+
 	for (i = 0; i < classes_available; i ++)
 		delete temp_sensor_class[i];
 
+	for (i = 0; i < (int)hal_data->hw_fifos_num; i++)
+		delete hal_data->hw_fifos[i];
+
 	st_hal_free_iio_devices_data(iio_devices_data, device_found_num);
 free_hal_data:
 	free(hal_data);
@@ -24,6 +24,7 @@
 
 #include "SensorBase.h"
 #include "SelfTest.h"
+#include "FlushCoalescer.h"
 #include "common_data.h"
 
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
@@ -117,6 +118,54 @@
 #define ST_HAL_NO_MOTION_SUFFIX_IIO			"_no_motion"
 #define ST_HAL_DEVICE_ORIENTATION_SUFFIX_IIO		"_dev_orientation"
 
+/* iio devices are probed concurrently at HAL open */
+#define ST_HAL_PROBE_MAX_THREADS			4
+
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+#define ST_HAL_CONFIG_QUEUE_LEN				64
+
+enum st_hal_config_cmd_id {
+	ST_HAL_CONFIG_CMD_ACTIVATE = 0,
+	ST_HAL_CONFIG_CMD_BATCH,
+};
+
+/*
+ * struct st_hal_config_cmd - activate/batch request
+ * @seq: queue sequence number, assigned when queued.
+ * @result: if not NULL, error of the request is stored here when applied.
+ */
+struct st_hal_config_cmd {
+	enum st_hal_config_cmd_id id;
+	unsigned int index;
+	int handle;
+	bool enable;
+	int64_t period_ns;
+	int64_t timeout;
+	uint64_t seq;
+	int *result;
+} typedef st_hal_config_cmd;
+
+/*
+ * struct st_hal_config_queue - activate/batch requests waiting to be applied
+ * @queued_seq: sequence number of latest queued request.
+ * @applied_seq: sequence number of latest applied request.
+ * @busy: worker is applying a request already removed from the queue.
+ * @running: worker thread is alive, requests are queued.
+ */
+struct st_hal_config_queue {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	st_hal_config_cmd cmd[ST_HAL_CONFIG_QUEUE_LEN];
+	unsigned int first;
+	unsigned int len;
+	uint64_t queued_seq;
+	uint64_t applied_seq;
+	bool busy;
+	bool running;
+} typedef st_hal_config_queue;
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
+
 #define ST_HAL_NEW_SENSOR_SUPPORTED(DRIVER_NAME, ANDROID_SENSOR_TYPE, IIO_SENSOR_TYPE, ANDROID_NAME, POWER_CONSUMPTION) \
 	{ \
 	.driver_name = DRIVER_NAME, \
@@ -165,10 +214,11 @@
 struct STSensorHAL_data {
 	sensors_poll_device_1 poll_device;
 
-	pthread_t *data_threads;
-	pthread_t *events_threads;
 	SensorBase *sensor_classes[ST_HAL_IIO_MAX_DEVICES];
 
+	FlushCoalescer *hw_fifos[ST_HAL_IIO_MAX_DEVICES];
+	unsigned int hw_fifos_num;
+
 	int last_handle;
 
 	unsigned int sensor_available;
@@ -179,6 +229,11 @@ struct STSensorHAL_data {
 #endif /* CONFIG_ST_HAL_HAS_SELFTEST_FUNCTIONS */
 
 	struct pollfd android_pollfd[ST_HAL_IIO_MAX_DEVICES];
+	SensorBase *android_pollfd_sensor[ST_HAL_IIO_MAX_DEVICES];
+
+#ifdef CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED
+	st_hal_config_queue config_queue;
+#endif /* CONFIG_ST_HAL_ASYNC_CONFIG_ENABLED */
 
 #ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
 	int mDirectChannelHandle;
@@ -0,0 +1,392 @@
+/*
+ * STMicroelectronics Sensor Output Pipe Class
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#define __STDC_FORMAT_MACROS
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <limits.h>
+
+#include "common_data.h"
+#include "SensorOutputPipe.h"
+
+#if CONFIG_ST_HAL_ANDROID_VERSION >= ST_HAL_OREO_VERSION
+#include <log/log.h>
+#else
+#include <cutils/log.h>
+#endif /* use log/log.h start from android 8 major version */
+
+/* writes up to PIPE_BUF bytes are atomic, events are never split */
+#define ST_SENSOR_OUTPUT_PIPE_ATOMIC_EVENTS		(PIPE_BUF / sizeof(sensors_event_t))
+
+static int64_t sensor_output_pipe_get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+SensorOutputPipe::SensorOutputPipe()
+{
+	pthread_mutex_init(&pipe_mutex, NULL);
+
+	fd = -EINVAL;
+	data_type = 0;
+	name = "";
+	policy = OUTPUT_PIPE_POLICY_BLOCK;
+
+	staging = NULL;
+	staging_first = 0;
+	staging_len = 0;
+	staging_max_len = 0;
+
+	memset(&stats, 0, sizeof(output_pipe_stats_t));
+	stats_logged = 0;
+	stats_log_timestamp = 0;
+}
+
+SensorOutputPipe::~SensorOutputPipe()
+{
+	free(staging);
+}
+
+/**
+ * init() - Attach write side of the pipe
+ * @pipe_fd: write file descriptor of the pipe.
+ * @pipe_name: name used in log messages.
+ * @type: sensor type of data events, other types are never dropped.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorOutputPipe::init(int pipe_fd, const char *pipe_name, int type)
+{
+	int flags;
+
+	/* pipe full is detected by EAGAIN, blocking policy uses poll() */
+	flags = fcntl(pipe_fd, F_GETFL);
+	if ((flags < 0) || (fcntl(pipe_fd, F_SETFL, flags | O_NONBLOCK) < 0))
+		return -errno;
+
+	fd = pipe_fd;
+	name = pipe_name;
+	data_type = type;
+
+	return 0;
+}
+
+/**
+ * setPolicy() - Set overflow policy of the pipe
+ * @new_policy: policy used when the pipe is full.
+ * @staging_events: number of events held while the pipe is full.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int SensorOutputPipe::setPolicy(OutputPipePolicy new_policy,
+				unsigned int staging_events)
+{
+	sensors_event_t *new_staging;
+
+	/* blocking policy falls back to staging if the reader stalls */
+	if (staging_events == 0)
+		staging_events = 1;
+
+	if (staging_events > ST_SENSOR_OUTPUT_PIPE_MAX_STAGING_EVENTS)
+		staging_events = ST_SENSOR_OUTPUT_PIPE_MAX_STAGING_EVENTS;
+
+	new_staging = (sensors_event_t *)malloc(staging_events * sizeof(sensors_event_t));
+	if (!new_staging)
+		return -ENOMEM;
+
+	pthread_mutex_lock(&pipe_mutex);
+
+	/* pending events are not lost switching policy */
+	if (staging_len > 0)
+		DrainStaging();
+
+	if (staging_len > 0) {
+		pthread_mutex_unlock(&pipe_mutex);
+		free(new_staging);
+		return -EBUSY;
+	}
+
+	free(staging);
+	staging = new_staging;
+	staging_first = 0;
+	staging_max_len = staging_events;
+	policy = new_policy;
+
+	pthread_mutex_unlock(&pipe_mutex);
+
+	return 0;
+}
+
+/**
+ * WriteNonBlocking() - Write as much events as possible
+ * @events: events to write.
+ * @num: number of events.
+ *
+ * Return value: number of events written, negative errno on fail.
+ **/
+int SensorOutputPipe::WriteNonBlocking(const sensors_event_t *events,
+				       unsigned int num)
+{
+	int err;
+	unsigned int written = 0, chunk;
+
+	while (written < num) {
+		chunk = num - written;
+		if (chunk > ST_SENSOR_OUTPUT_PIPE_ATOMIC_EVENTS)
+			chunk = ST_SENSOR_OUTPUT_PIPE_ATOMIC_EVENTS;
+
+		err = write(fd, &events[written], chunk * sizeof(sensors_event_t));
+		if (err < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				break;
+
+			if (errno == EINTR)
+				continue;
+
+			return -errno;
+		}
+
+		written += err / sizeof(sensors_event_t);
+		if ((unsigned int)err < chunk * sizeof(sensors_event_t))
+			break;
+	}
+
+	return written;
+}
+
+/**
+ * WriteBlocking() - Write events waiting for room in the pipe
+ * @events: events to write.
+ * @num: number of events.
+ *
+ * Wait is bounded so a stalled reader cannot hold the sensor thread (and
+ * its stop request) forever.
+ *
+ * Return value: number of events written, negative errno on fail.
+ **/
+int SensorOutputPipe::WriteBlocking(const sensors_event_t *events,
+				    unsigned int num)
+{
+	int err;
+	int64_t deadline, timeout_ms;
+	unsigned int written = 0;
+	struct pollfd pollfd_pipe;
+
+	pollfd_pipe.fd = fd;
+	pollfd_pipe.events = POLLOUT;
+
+	deadline = sensor_output_pipe_get_time() +
+		   ST_SENSOR_OUTPUT_PIPE_BLOCK_TIMEOUT_MS * 1000000LL;
+
+	while (true) {
+		err = WriteNonBlocking(&events[written], num - written);
+		if (err < 0)
+			return err;
+
+		written += err;
+		if (written == num)
+			break;
+
+		timeout_ms = (deadline - sensor_output_pipe_get_time()) / 1000000LL;
+		if (timeout_ms <= 0)
+			break;
+
+		stats.delayed += num - written;
+		poll(&pollfd_pipe, 1, (int)timeout_ms);
+	}
+
+	return written;
+}
+
+int SensorOutputPipe::DrainStaging()
+{
+	int err;
+	unsigned int span;
+
+	while (staging_len > 0) {
+		span = staging_max_len - staging_first;
+		if (span > staging_len)
+			span = staging_len;
+
+		err = WriteNonBlocking(&staging[staging_first], span);
+		if (err < 0)
+			return err;
+
+		staging_first = (staging_first + err) % staging_max_len;
+		staging_len -= err;
+		stats.written += err;
+		stats.delayed += err;
+
+		if ((unsigned int)err < span)
+			return -EAGAIN;
+	}
+
+	staging_first = 0;
+
+	return 0;
+}
+
+void SensorOutputPipe::StageEvent(const sensors_event_t *event)
+{
+	unsigned int i, index, next;
+	bool droppable = (event->type == data_type);
+
+	if (droppable) {
+		switch (policy) {
+		case OUTPUT_PIPE_POLICY_DROP_NEWEST:
+			stats.dropped++;
+			return;
+
+		case OUTPUT_PIPE_POLICY_COALESCE:
+			index = (staging_first + staging_len - 1) % staging_max_len;
+			if ((staging_len > 0) && (staging[index].type == data_type)) {
+				memcpy(&staging[index], event, sizeof(sensors_event_t));
+				stats.coalesced++;
+				return;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (staging_len == staging_max_len) {
+		/* make room removing the oldest data event */
+		for (i = 0; i < staging_len; i++) {
+			index = (staging_first + i) % staging_max_len;
+			if (staging[index].type == data_type)
+				break;
+		}
+
+		if (i == staging_len) {
+			ALOGE("%s: Output pipe staging full of control events, event lost.", name);
+			stats.dropped++;
+			return;
+		}
+
+		for (; i > 0; i--) {
+			index = (staging_first + i) % staging_max_len;
+			next = (staging_first + i - 1) % staging_max_len;
+			memcpy(&staging[index], &staging[next], sizeof(sensors_event_t));
+		}
+
+		staging_first = (staging_first + 1) % staging_max_len;
+		staging_len--;
+		stats.dropped++;
+	}
+
+	index = (staging_first + staging_len) % staging_max_len;
+	memcpy(&staging[index], event, sizeof(sensors_event_t));
+	staging_len++;
+}
+
+void SensorOutputPipe::LogStats()
+{
+	int64_t now;
+	uint64_t overflow_events;
+
+	overflow_events = stats.dropped + stats.coalesced + stats.delayed;
+	if (overflow_events == stats_logged)
+		return;
+
+	now = sensor_output_pipe_get_time();
+	if ((now - stats_log_timestamp) < ST_SENSOR_OUTPUT_PIPE_LOG_INTERVAL)
+		return;
+
+	ALOGW("%s: output pipe full: dropped=%" PRIu64 " coalesced=%" PRIu64 " delayed=%" PRIu64 " written=%" PRIu64 ".",
+	      name, stats.dropped, stats.coalesced, stats.delayed, stats.written);
+
+	stats_logged = overflow_events;
+	stats_log_timestamp = now;
+}
+
+/**
+ * writeEvents() - Write events to android following overflow policy
+ * @events: events to write.
+ * @num: number of events.
+ *
+ * Return value: number of events written or held, negative errno on fail.
+ **/
+int SensorOutputPipe::writeEvents(const sensors_event_t *events,
+				  unsigned int num)
+{
+	int err;
+	unsigned int i = 0;
+
+	pthread_mutex_lock(&pipe_mutex);
+
+	if (staging_len > 0) {
+		err = DrainStaging();
+		if ((err < 0) && (err != -EAGAIN))
+			goto unlock_mutex;
+	}
+
+	/*
+	 * events can be written directly only if nothing is pending, blocking
+	 * policy does not wait again while the reader is still stalled.
+	 */
+	if (staging_len == 0) {
+		if (policy == OUTPUT_PIPE_POLICY_BLOCK)
+			err = WriteBlocking(events, num);
+		else
+			err = WriteNonBlocking(events, num);
+		if (err < 0)
+			goto unlock_mutex;
+
+		stats.written += err;
+		i = err;
+	}
+
+	for (; i < num; i++)
+		StageEvent(&events[i]);
+
+	err = num;
+
+unlock_mutex:
+	LogStats();
+	pthread_mutex_unlock(&pipe_mutex);
+
+	return err;
+}
+
+/**
+ * drain() - Write events held while the pipe was full
+ *
+ * Return value: 0 on success, negative errno if still pending or on fail.
+ **/
+int SensorOutputPipe::drain()
+{
+	int err = 0;
+
+	pthread_mutex_lock(&pipe_mutex);
+
+	if (staging_len > 0)
+		err = DrainStaging();
+
+	pthread_mutex_unlock(&pipe_mutex);
+
+	return err;
+}
+
+void SensorOutputPipe::getStats(output_pipe_stats_t *pipe_stats)
+{
+	pthread_mutex_lock(&pipe_mutex);
+	memcpy(pipe_stats, &stats, sizeof(output_pipe_stats_t));
+	pthread_mutex_unlock(&pipe_mutex);
+}
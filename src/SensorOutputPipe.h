@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015-2016 STMicroelectronics
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ST_SENSOR_OUTPUT_PIPE_H
+#define ST_SENSOR_OUTPUT_PIPE_H
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include <hardware/sensors.h>
+
+#define ST_SENSOR_OUTPUT_PIPE_MAX_STAGING_EVENTS	(256)
+#define ST_SENSOR_OUTPUT_PIPE_LOG_INTERVAL		(1000000000LL)
+#define ST_SENSOR_OUTPUT_PIPE_BLOCK_TIMEOUT_MS		(100)
+
+typedef enum OutputPipePolicy {
+	OUTPUT_PIPE_POLICY_BLOCK = 0,
+	OUTPUT_PIPE_POLICY_DROP_NEWEST,
+	OUTPUT_PIPE_POLICY_DROP_OLDEST,
+	OUTPUT_PIPE_POLICY_COALESCE,
+} OutputPipePolicy;
+
+typedef struct output_pipe_stats {
+	uint64_t written;
+	uint64_t dropped;
+	uint64_t coalesced;
+	uint64_t delayed;
+} output_pipe_stats_t;
+
+/*
+ * class SensorOutputPipe
+ *
+ * Write side of the pipe read by android poll(). When the pipe is full
+ * (framework too slow) events are handled following the overflow policy.
+ * Meta data and additional info events are never dropped nor coalesced.
+ * Blocking policy waits at most ST_SENSOR_OUTPUT_PIPE_BLOCK_TIMEOUT_MS,
+ * then drops oldest events until the reader catches up.
+ */
+class SensorOutputPipe {
+private:
+	pthread_mutex_t pipe_mutex;
+	int fd;
+	int data_type;
+	const char *name;
+	OutputPipePolicy policy;
+
+	sensors_event_t *staging;
+	unsigned int staging_first, staging_len, staging_max_len;
+
+	output_pipe_stats_t stats;
+	uint64_t stats_logged;
+	int64_t stats_log_timestamp;
+
+	int WriteNonBlocking(const sensors_event_t *events, unsigned int num);
+	int WriteBlocking(const sensors_event_t *events, unsigned int num);
+	int DrainStaging();
+	void StageEvent(const sensors_event_t *event);
+	void LogStats();
+
+public:
+	SensorOutputPipe();
+	~SensorOutputPipe();
+
+	int init(int pipe_fd, const char *pipe_name, int type);
+	int setPolicy(OutputPipePolicy new_policy, unsigned int staging_events);
+
+	int writeEvents(const sensors_event_t *events, unsigned int num);
+	int drain();
+	void getStats(output_pipe_stats_t *pipe_stats);
+};
+
+#endif /* ST_SENSOR_OUTPUT_PIPE_H */
@@ -0,0 +1,220 @@
+/*
+ * STMicroelectronics Sensor Output Tap Class
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#define __STDC_LIMIT_MACROS
+#define __STDINT_LIMITS
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SensorOutputTap.h"
+
+SensorOutputTap::SensorOutputTap()
+{
+	pthread_mutex_init(&tap_mutex, NULL);
+
+	period_ns = 0;
+	timeout_ns = INT64_MAX;
+	last_output_timestamp = 0;
+	batch_first_timestamp = 0;
+
+	batch_len = 0;
+	batch_max_len = 0;
+	batch = NULL;
+}
+
+SensorOutputTap::~SensorOutputTap()
+{
+	free(batch);
+}
+
+/**
+ * setMaxBatchLength() - Set max number of events the tap can hold
+ * @len: max number of events, 0 or 1 means batching not supported.
+ **/
+void SensorOutputTap::setMaxBatchLength(unsigned int len)
+{
+	pthread_mutex_lock(&tap_mutex);
+
+	if (len > ST_SENSOR_OUTPUT_TAP_MAX_BATCH_EVENTS)
+		len = ST_SENSOR_OUTPUT_TAP_MAX_BATCH_EVENTS;
+
+	if (!batch)
+		batch_max_len = len;
+
+	pthread_mutex_unlock(&tap_mutex);
+}
+
+/**
+ * setPeriod() - Set output period of the consumer
+ * @period: output period in ns, 0 means every sample.
+ **/
+void SensorOutputTap::setPeriod(int64_t period)
+{
+	period_ns = period;
+}
+
+/**
+ * setTimeout() - Set max report latency of the consumer
+ * @timeout: max report latency in ns, 0 or INT64_MAX means no batching.
+ **/
+void SensorOutputTap::setTimeout(int64_t timeout)
+{
+	pthread_mutex_lock(&tap_mutex);
+
+	timeout_ns = timeout;
+
+	/* batch buffer is allocated only once a consumer ask for it */
+	if ((timeout > 0) && (timeout < INT64_MAX) &&
+	    (batch_max_len > 1) && !batch) {
+		batch = (sensors_event_t *)malloc(batch_max_len * sizeof(sensors_event_t));
+		if (!batch)
+			batch_max_len = 0;
+	}
+
+	pthread_mutex_unlock(&tap_mutex);
+}
+
+int64_t SensorOutputTap::getPeriod()
+{
+	return period_ns;
+}
+
+/**
+ * decimate() - Check if a sample of the stream belongs to this tap
+ * @timestamp: timestamp of the sample.
+ * @hw_pollrate: period of the stream feeding the tap.
+ * @force: output the sample whatever the period is (ie. odr switch).
+ *
+ * Return value: true if the sample must be forwarded to the consumer.
+ **/
+bool SensorOutputTap::decimate(int64_t timestamp, int64_t hw_pollrate, bool force)
+{
+	int64_t period = period_ns;
+
+	if (force || (last_output_timestamp == 0) || (period <= hw_pollrate)) {
+		last_output_timestamp = timestamp;
+		return true;
+	}
+
+	/* half stream period tolerance absorbs timestamp jitter */
+	if ((timestamp - last_output_timestamp + (hw_pollrate / 2)) >= period) {
+		last_output_timestamp = timestamp;
+		return true;
+	}
+
+	return false;
+}
+
+int64_t SensorOutputTap::GetBatchLatency()
+{
+	if ((timeout_ns <= 0) || (timeout_ns == INT64_MAX))
+		return 0;
+
+	if (timeout_ns < ST_SENSOR_OUTPUT_TAP_LATENCY_MARGIN)
+		return 0;
+
+	return timeout_ns - ST_SENSOR_OUTPUT_TAP_LATENCY_MARGIN;
+}
+
+/**
+ * getBatchDeadline() - Get time when the batch must be delivered
+ *
+ * Return value: timestamp of the deadline, INT64_MAX if batch is empty.
+ **/
+int64_t SensorOutputTap::getBatchDeadline()
+{
+	int64_t deadline = INT64_MAX;
+
+	pthread_mutex_lock(&tap_mutex);
+
+	if (batch_len > 0)
+		deadline = batch_first_timestamp + GetBatchLatency();
+
+	pthread_mutex_unlock(&tap_mutex);
+
+	return deadline;
+}
+
+int SensorOutputTap::WriteBatch(SensorOutputPipe *pipe)
+{
+	unsigned int len = batch_len;
+
+	batch_len = 0;
+
+	return pipe->writeEvents(batch, len);
+}
+
+/**
+ * writeEvent() - Write event to consumer pipe or hold it into the batch
+ * @pipe: output pipe of the consumer.
+ * @event: event to output.
+ *
+ * Return value: 0 or number of events written, negative errno on fail.
+ **/
+int SensorOutputTap::writeEvent(SensorOutputPipe *pipe, const sensors_event_t *event)
+{
+	int err;
+
+	pthread_mutex_lock(&tap_mutex);
+
+	if (!batch) {
+		pthread_mutex_unlock(&tap_mutex);
+
+		return pipe->writeEvents(event, 1);
+	}
+
+	if (batch_len == 0)
+		batch_first_timestamp = event->timestamp;
+
+	memcpy(&batch[batch_len], event, sizeof(sensors_event_t));
+	batch_len++;
+
+	if ((batch_len >= batch_max_len) ||
+	    ((event->timestamp - batch_first_timestamp) >= GetBatchLatency()))
+		err = WriteBatch(pipe);
+	else
+		err = 0;
+
+	pthread_mutex_unlock(&tap_mutex);
+
+	return err;
+}
+
+/**
+ * flush() - Write all events held by the batch
+ * @pipe: output pipe of the consumer.
+ *
+ * Return value: number of events written, negative errno on fail.
+ **/
+int SensorOutputTap::flush(SensorOutputPipe *pipe)
+{
+	int err = 0;
+
+	pthread_mutex_lock(&tap_mutex);
+
+	if (batch_len > 0)
+		err = WriteBatch(pipe);
+
+	pthread_mutex_unlock(&tap_mutex);
+
+	return err;
+}
+
+void SensorOutputTap::reset()
+{
+	pthread_mutex_lock(&tap_mutex);
+
+	batch_len = 0;
+	last_output_timestamp = 0;
+
+	pthread_mutex_unlock(&tap_mutex);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015-2016 STMicroelectronics
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ST_SENSOR_OUTPUT_TAP_H
+#define ST_SENSOR_OUTPUT_TAP_H
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include <hardware/sensors.h>
+
+#include "SensorOutputPipe.h"
+
+#define ST_SENSOR_OUTPUT_TAP_MAX_BATCH_EVENTS		(128)
+#define ST_SENSOR_OUTPUT_TAP_LATENCY_MARGIN		(500000000LL)
+
+/*
+ * class SensorOutputTap
+ *
+ * One consumer view of a sensor stream. The stream is generated at the
+ * minimum period requested by all consumers, every tap decimates it
+ * with its own period and (optionally) holds the events in a HAL-side
+ * batch until its own max report latency expires.
+ */
+class SensorOutputTap {
+private:
+	pthread_mutex_t tap_mutex;
+
+	int64_t period_ns;
+	int64_t timeout_ns;
+	int64_t last_output_timestamp;
+	int64_t batch_first_timestamp;
+
+	unsigned int batch_len;
+	unsigned int batch_max_len;
+	sensors_event_t *batch;
+
+	int64_t GetBatchLatency();
+	int WriteBatch(SensorOutputPipe *pipe);
+
+public:
+	SensorOutputTap();
+	~SensorOutputTap();
+
+	void setMaxBatchLength(unsigned int len);
+	void setPeriod(int64_t period);
+	void setTimeout(int64_t timeout);
+	int64_t getPeriod();
+	int64_t getBatchDeadline();
+
+	bool decimate(int64_t timestamp, int64_t hw_pollrate, bool force);
+	int writeEvent(SensorOutputPipe *pipe, const sensors_event_t *event);
+	int flush(SensorOutputPipe *pipe);
+	void reset();
+};
+
+#endif /* ST_SENSOR_OUTPUT_TAP_H */
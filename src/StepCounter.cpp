@@ -30,6 +30,9 @@ StepCounter::StepCounter(HWSensorBaseCommonData *data, const char *name,
 
 	sensor_t_data.resolution = 1.0f;
 	sensor_t_data.maxRange = pow(2, data->channels[0].bits_used) - 1;
+
+	/* on-change sensor: never report the same number of steps twice */
+	SetChangeDetection(sensor_t_data.resolution, 0.0f, 0);
 }
 
 StepCounter::~StepCounter()
@@ -43,14 +46,14 @@ int StepCounter::Enable(int handle, bool enable, bool lock_en_mutex)
 	bool old_status;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	old_status = GetStatus(false);
 
 	err = HWSensorBase::Enable(handle, enable, false);
 	if (err < 0) {
 		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+			pthread_mutex_unlock(&config_mutex);
 
 		return err;
 	}
@@ -59,7 +62,7 @@ int StepCounter::Enable(int handle, bool enable, bool lock_en_mutex)
 		last_data_timestamp = 0;
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
 }
@@ -68,33 +71,31 @@ int StepCounter::SetDelay(int handle, int64_t period_ns, int64_t timeout, bool l
 {
 	int err;
 	int64_t min_pollrate_ns;
-	int64_t restore_min_period_ms;
+	int64_t restore_period_ns, restore_timeout;
 
 	if (lock_en_mutex)
-		pthread_mutex_lock(&enable_mutex);
+		pthread_mutex_lock(&config_mutex);
 
 	err = HWSensorBase::SetDelay(handle, period_ns, timeout, false);
-	if (err < 0) {
-		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
+	if (err < 0)
+		goto mutex_unlock;
 
-		return err;
-	}
+	/*
+	 * HWSensorBase::SetDelay() does not record the request, store it
+	 * here so the max delivery rate is computed on the current table.
+	 */
+	rates.get(handle, &restore_period_ns, &restore_timeout);
+
+	err = rates.set(handle, period_ns, timeout);
+	if (err < 0)
+		goto mutex_unlock;
 
-	restore_min_period_ms = period_ns;
-	sensors_pollrates[handle] = period_ns;
 	min_pollrate_ns = GetMinPeriod(false);
 
 	err = device_iio_utils::set_max_delivery_rate(common_data.device_iio_sysfs_path,
 						      NS_TO_MS(min_pollrate_ns));
-	if (err < 0) {
-		if (lock_en_mutex)
-			pthread_mutex_unlock(&enable_mutex);
-
-		sensors_pollrates[handle] = restore_min_period_ms;
-
-		return err;
-	}
+	if (err < 0)
+		goto restore_rate;
 
 #if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_INFO)
 	if (handle == sensor_t_data.handle)
@@ -103,9 +104,17 @@ int StepCounter::SetDelay(int handle, int64_t period_ns, int64_t timeout, bool l
 #endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
 
 	if (lock_en_mutex)
-		pthread_mutex_unlock(&enable_mutex);
+		pthread_mutex_unlock(&config_mutex);
 
 	return 0;
+
+restore_rate:
+	rates.set(handle, restore_period_ns, restore_timeout);
+mutex_unlock:
+	if (lock_en_mutex)
+		pthread_mutex_unlock(&config_mutex);
+
+	return err;
 }
 
 void StepCounter::ProcessData(SensorBaseData *data)
@@ -117,6 +126,9 @@ void StepCounter::ProcessData(SensorBaseData *data)
 	ALOGD("\"%s\": received new sensor data: s=%f, timestamp=%" PRIu64 "ns (sensor type: %d).", sensor_t_data.name, data->raw[0], data->timestamp, sensor_t_data.type);
 #endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
 
-	HWSensorBase::WriteDataToPipe(0);
+	if (ValidDataToPush(data->timestamp) &&
+	    ChangeDetected(data->raw[0], data->timestamp))
+		HWSensorBase::WriteDataToPipe(0);
+
 	HWSensorBase::ProcessData(data);
 }
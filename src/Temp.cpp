@@ -33,6 +33,13 @@ Temp::Temp(HWSensorBaseCommonData *data, const char *name,
 
 	sensor_t_data.resolution = fabs(data->channels[0].scale);
 	sensor_t_data.maxRange = sensor_t_data.resolution * (pow(2, data->channels[0].bits_used) - 1);
+
+#ifdef CONFIG_ST_HAL_CHANGE_DETECTION_ENABLED
+	SetChangeDetection(fmaxf(sensor_t_data.resolution,
+				 CONFIG_ST_HAL_TEMP_CHANGE_THRESHOLD / 1000.0f),
+			   CONFIG_ST_HAL_CHANGE_RELATIVE_THRESHOLD / 1000000.0f,
+			   CONFIG_ST_HAL_CHANGE_HEARTBEAT * 1000000LL);
+#endif /* CONFIG_ST_HAL_CHANGE_DETECTION_ENABLED */
 }
 
 void Temp::ProcessData(SensorBaseData *data)
@@ -39,6 +39,7 @@
 
 #define ST_HAL_DATA_PATH				"/data/STSensorHAL"
 #define ST_HAL_PRIVATE_DATA_PATH			"/data/STSensorHAL/private_data.dat"
+#define ST_HAL_IIO_CACHE_DATA_PATH			"/data/STSensorHAL/iio_cache"
 #define ST_HAL_FACTORY_DATA_PATH			"/data/STSensorHAL/factory_calibration"
 #define ST_HAL_SELFTEST_DATA_PATH			"/data/STSensorHAL/selftest"
 #define ST_HAL_SELFTEST_CMD_DATA_PATH			"/data/STSensorHAL/selftest/cmd"
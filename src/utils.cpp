@@ -14,6 +14,8 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "utils.h"
 
@@ -36,6 +38,7 @@ static const char *device_iio_device_name = "iio:device";
 static const char *device_iio_injection_mode_enable = "injection_mode";
 static const char *device_iio_injection_sensors_filename = "injection_sensors";
 static const char *device_iio_current_timestamp_clock = "current_timestamp_clock";
+static const char *device_iio_timestamp_channel = "in_timestamp";
 static const char *device_iio_scan_elements_en = "_en";
 static const char *device_iio_selftest_available_filename = "selftest_available";
 static const char *device_iio_selftest_filename = "selftest";
@@ -194,6 +197,56 @@ int device_iio_utils::check_file(char *filename)
 	return stat(filename, &info);
 }
 
+/**
+ * sysfs_open_attr() - Open sysfs attribute for write
+ * @device_dir: iio device sysfs path.
+ * @attr: attribute name, relative to device_dir.
+ *
+ * Return value: file descriptor, negative errno on fail.
+ **/
+int device_iio_utils::sysfs_open_attr(const char *device_dir, const char *attr)
+{
+	char filename[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+	int fd, ret;
+
+	ret = snprintf(filename, sizeof(filename), "%s/%s", device_dir, attr);
+	if ((ret < 0) || (ret >= (int)sizeof(filename)))
+		return -ENOMEM;
+
+	fd = open(filename, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	return fd;
+}
+
+/**
+ * sysfs_pwrite_uint() - Write unsigned value to an open sysfs attribute
+ * @fd: file descriptor returned by sysfs_open_attr().
+ * @val: value to write.
+ *
+ * sysfs store is always performed at offset 0, so the same fd can be
+ * rewritten without seek or reopen.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int device_iio_utils::sysfs_pwrite_uint(int fd, unsigned int val)
+{
+	char buf[12];
+	int len, ret;
+
+	len = snprintf(buf, sizeof(buf), "%u", val);
+
+	do {
+		ret = pwrite(fd, buf, len, 0);
+	} while ((ret < 0) && (errno == EINTR));
+
+	if (ret < 0)
+		return -errno;
+
+	return (ret == len) ? 0 : -EIO;
+}
+
 int device_iio_utils::sysfs_enable_channels(const char *device_dir, bool enable)
 {
 	char dir[DEVICE_IIO_MAX_FILENAME_LEN + 1];
@@ -487,6 +540,286 @@ error_cleanup_array:
 	return ret;
 }
 
+static uint32_t device_iio_hash_name(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	/* FNV-1a */
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static int device_iio_hash_dir(const char *dir, uint32_t *hash)
+{
+	const struct dirent *ent;
+	DIR *dp;
+
+	dp = opendir(dir);
+	if (!dp)
+		return -errno;
+
+	/* readdir order is not guaranteed, sum is order independent */
+	while (ent = readdir(dp), ent != NULL)
+		*hash += device_iio_hash_name(ent->d_name);
+
+	closedir(dp);
+
+	return 0;
+}
+
+/**
+ * get_attributes_hash() - Hash names of sysfs attributes of iio device
+ * @device_dir: iio device sysfs path.
+ * @hash: hash of device and scan_elements attributes names.
+ *
+ * Only directories are read, no attribute is opened.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int device_iio_utils::get_attributes_hash(const char *device_dir, uint32_t *hash)
+{
+	char dir[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+	int err;
+
+	*hash = 0;
+
+	err = device_iio_hash_dir(device_dir, hash);
+	if (err < 0)
+		return err;
+
+	snprintf(dir, sizeof(dir), "%s/scan_elements", device_dir);
+
+	err = device_iio_hash_dir(dir, hash);
+	if (err < 0 && err != -ENOENT)
+		return err;
+
+	return 0;
+}
+
+/**
+ * enable_channel() - Enable or disable single scan element
+ * @device_dir: iio device sysfs path.
+ * @name: channel name (scan element without _en suffix).
+ * @enable: enable or disable channel.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int device_iio_utils::enable_channel(const char *device_dir,
+				     const char *name, bool enable)
+{
+	char filename[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+	int ret;
+
+	ret = snprintf(filename, sizeof(filename), "%s/scan_elements/%s%s",
+		       device_dir, name, device_iio_scan_elements_en);
+	if ((ret < 0) || (ret >= (int)sizeof(filename)))
+		return -ENOMEM;
+
+	return sysfs_write_uint(filename, enable ? ENABLE_CHANNEL : DISABLE_CHANNEL);
+}
+
+/**
+ * is_timestamp_channel() - Check if channel is the scan timestamp
+ * @channel: channel information.
+ *
+ * Timestamp is the IIO_TIMESTAMP scan element or, if the driver names it
+ * differently, the signed 64 bits channel.
+ **/
+bool device_iio_utils::is_timestamp_channel(const struct device_iio_info_channel *channel)
+{
+	if (!strcmp(channel->name, device_iio_timestamp_channel))
+		return true;
+
+	return (channel->bytes == 8) && (channel->bits_used == 64) && channel->sign;
+}
+
+/**
+ * select_channels() - Keep only channels used by sensor class
+ * @device_dir: iio device sysfs path.
+ * @channels: channels in scan index order, reduced in place.
+ * @num_channels: number of channels, updated.
+ * @data_channels: number of data channels used, negative means all.
+ * @enable_used: write enable of used channels (not done by scan).
+ *
+ * The first data_channels data channels and the timestamp channel are
+ * kept, unused channels are disabled and removed from channels array.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int device_iio_utils::select_channels(const char *device_dir,
+				      struct device_iio_info_channel *channels,
+				      int *num_channels, int data_channels,
+				      bool enable_used)
+{
+	int i, n, err, used = 0;
+	bool timestamp;
+
+	for (i = 0, n = 0; i < *num_channels; i++) {
+		timestamp = is_timestamp_channel(&channels[i]);
+
+		if ((data_channels < 0) || (used < data_channels) || timestamp) {
+			if (enable_used) {
+				err = enable_channel(device_dir, channels[i].name, true);
+				if (err < 0)
+					return err;
+			}
+
+			if (!timestamp)
+				used++;
+
+			channels[n++] = channels[i];
+			continue;
+		}
+
+		err = enable_channel(device_dir, channels[i].name, false);
+		if (err < 0)
+			return err;
+
+#if (CONFIG_ST_HAL_DEBUG_LEVEL >= ST_HAL_DEBUG_VERBOSE)
+		ALOGD("%s: channel %s not used, disabled.",
+		      device_dir, channels[i].name);
+#endif /* CONFIG_ST_HAL_DEBUG_LEVEL */
+
+		free(channels[i].name);
+	}
+
+	*num_channels = n;
+
+	return 0;
+}
+
+/**
+ * get_scan_size() - Calculate the storage size of a scan
+ * @channels: the channel info array, location of channels is filled.
+ * @num_channels: number of channels.
+ *
+ * Every channel is aligned to its own storage size.
+ *
+ * Return value: bytes of a scan.
+ **/
+int device_iio_utils::get_scan_size(struct device_iio_info_channel *channels,
+				    int num_channels)
+{
+	int bytes = 0, i;
+
+	for (i = 0; i < num_channels; i++) {
+		channels[i].location = 0;
+
+		if (channels[i].bytes == 0)
+			continue;
+
+		if (bytes % channels[i].bytes == 0)
+			channels[i].location = bytes;
+		else
+			channels[i].location = bytes -
+				(bytes % channels[i].bytes) + channels[i].bytes;
+
+		bytes = channels[i].location + channels[i].bytes;
+	}
+
+	return bytes;
+}
+
+/**
+ * device_iio_read_type() - Read scan element format of a channel
+ * @filename: scan element type file.
+ * @channel: channel information, format fields are filled.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+static int device_iio_read_type(const char *filename,
+				struct device_iio_info_channel *channel)
+{
+	int ret;
+	FILE *sysfsfp;
+	unsigned int padint;
+	char signchar, endianchar;
+
+	sysfsfp = fopen(filename, "r");
+	if (sysfsfp == NULL)
+		return -errno;
+
+	/* scan format like "le:s16/16>>0" */
+	ret = fscanf(sysfsfp, "%ce:%c%u/%u>>%u",
+		     &endianchar,
+		     &signchar,
+		     &channel->bits_used,
+		     &padint,
+		     &channel->shift);
+	fclose(sysfsfp);
+	if (ret != 5)
+		return -EINVAL;
+
+	channel->be = (endianchar == 'b');
+	channel->sign = (signchar == 's');
+	channel->bytes = (padint >> 3);
+
+	if (channel->bits_used == 64)
+		channel->mask = ~0;
+	else
+		channel->mask = (1 << channel->bits_used) - 1;
+
+	return 0;
+}
+
+/**
+ * check_channel() - Check channel information still match sysfs
+ * @device_dir: iio device sysfs path.
+ * @channel: channel information to check.
+ *
+ * Scan index and scan element format (type) are checked.
+ *
+ * Return value: 0 if channel match, -ESTALE if not, negative errno on fail.
+ **/
+int device_iio_utils::check_channel(const char *device_dir,
+				    const struct device_iio_info_channel *channel)
+{
+	char filename[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+	struct device_iio_info_channel type;
+	unsigned int index;
+	int ret;
+
+	ret = snprintf(filename, sizeof(filename), "%s/scan_elements/%s_index",
+		       device_dir, channel->name);
+	if ((ret < 0) || (ret >= (int)sizeof(filename)))
+		return -ENOMEM;
+
+	ret = sysfs_read_uint(filename, &index);
+	if (ret < 0)
+		return ret;
+
+	if ((ret != 1) || (index != channel->index))
+		return -ESTALE;
+
+	ret = snprintf(filename, sizeof(filename), "%s/scan_elements/%s_type",
+		       device_dir, channel->name);
+	if ((ret < 0) || (ret >= (int)sizeof(filename)))
+		return -ENOMEM;
+
+	ret = device_iio_read_type(filename, &type);
+	if (ret == -ENOENT) {
+		/* format shared by all channels, as in get_type() */
+		snprintf(filename, sizeof(filename), "%s/scan_elements/in_type",
+			 device_dir);
+		ret = device_iio_read_type(filename, &type);
+	}
+	if (ret < 0)
+		return (ret == -EINVAL) ? -ESTALE : ret;
+
+	if ((type.bytes != channel->bytes) ||
+	    (type.bits_used != channel->bits_used) ||
+	    (type.shift != channel->shift) ||
+	    (type.be != channel->be) ||
+	    (type.sign != channel->sign))
+		return -ESTALE;
+
+	return 0;
+}
+
 int device_iio_utils::enable_events(const char *device_dir, bool enable)
 {
 	char event_el_dir[DEVICE_IIO_MAX_FILENAME_LEN + 1];
@@ -557,7 +890,7 @@ int device_iio_utils::get_sampling_frequency_available(char *device_dir,
 {
 	int err = 0;
 	char sf_filaname[DEVICE_IIO_MAX_FILENAME_LEN];
-	char *pch;
+	char *pch, *saveptr;
 	char line[100];
 
 	sfa->length = 0;
@@ -573,10 +906,10 @@ int device_iio_utils::get_sampling_frequency_available(char *device_dir,
 	if (err < 0)
 		return err;
 
-	pch = strtok(line," ,");
+	pch = strtok_r(line, " ,", &saveptr);
 	while (pch != NULL) {
 		sfa->freq[sfa->length] = atof(pch);
-		pch = strtok(NULL, " ,");
+		pch = strtok_r(NULL, " ,", &saveptr);
 		sfa->length++;
 		if (sfa->length >= DEVICE_IIO_MAX_SAMP_FREQ_AVAILABLE)
 			break;
@@ -713,6 +1046,255 @@ int device_iio_utils::hw_fifo_flush(char *device_dir)
 	return sysfs_write_int(tmp_filaname, 1);
 }
 
+/**
+ * open_sysfs_fds() - Open runtime sysfs attributes of iio device
+ * @device_dir: iio device sysfs path.
+ * @fds: file descriptors.
+ *
+ * Missing attributes are not an error, they are skipped on write.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int device_iio_utils::open_sysfs_fds(const char *device_dir,
+				     struct device_iio_sysfs_fds *fds)
+{
+	char event_el_dir[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+	char filename[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+	const struct dirent *ent;
+	int err;
+	DIR *dp;
+
+	fds->buffer_enable = sysfs_open_attr(device_dir,
+					     device_iio_buffer_enable);
+	fds->sampling_frequency = sysfs_open_attr(device_dir,
+						  device_iio_sf_filename);
+	fds->hw_fifo_watermark = sysfs_open_attr(device_dir,
+						 device_iio_hw_fifo_watermark);
+	fds->hw_fifo_flush = sysfs_open_attr(device_dir,
+					     device_iio_hw_fifo_flush);
+	fds->events_num = 0;
+
+	fds->current.buffer_enable = DEVICE_IIO_SYSFS_VALUE_UNKNOWN;
+	fds->current.sampling_frequency = DEVICE_IIO_SYSFS_VALUE_UNKNOWN;
+	fds->current.hw_fifo_watermark = DEVICE_IIO_SYSFS_VALUE_UNKNOWN;
+
+	err = snprintf(event_el_dir, sizeof(event_el_dir),
+		       device_iio_event_dir, device_dir);
+	if (err < 0)
+		return -ENOMEM;
+
+	dp = opendir(event_el_dir);
+	if (!dp)
+		return (errno == ENOENT) ? 0 : -errno;
+
+	err = 0;
+	while (ent = readdir(dp), ent != NULL) {
+		if (strlen(ent->d_name) < strlen(device_iio_scan_elements_en))
+			continue;
+
+		if (strcmp(ent->d_name + strlen(ent->d_name) -
+			   strlen(device_iio_scan_elements_en),
+			   device_iio_scan_elements_en))
+			continue;
+
+		if (fds->events_num >= DEVICE_IIO_MAX_EVENT_FDS) {
+			ALOGE("%s: too many events, %s not handled.",
+			      device_dir, ent->d_name);
+			continue;
+		}
+
+		err = snprintf(filename, sizeof(filename), "events/%s",
+			       ent->d_name);
+		if (err < 0) {
+			err = -ENOMEM;
+			break;
+		}
+
+		err = sysfs_open_attr(device_dir, filename);
+		if (err < 0)
+			break;
+
+		fds->events_enable[fds->events_num++] = err;
+		err = 0;
+	}
+
+	closedir(dp);
+
+	return err;
+}
+
+void device_iio_utils::close_sysfs_fds(struct device_iio_sysfs_fds *fds)
+{
+	unsigned int i;
+
+	if (fds->buffer_enable >= 0)
+		close(fds->buffer_enable);
+
+	if (fds->sampling_frequency >= 0)
+		close(fds->sampling_frequency);
+
+	if (fds->hw_fifo_watermark >= 0)
+		close(fds->hw_fifo_watermark);
+
+	if (fds->hw_fifo_flush >= 0)
+		close(fds->hw_fifo_flush);
+
+	for (i = 0; i < fds->events_num; i++)
+		close(fds->events_enable[i]);
+
+	fds->buffer_enable = -ENOENT;
+	fds->sampling_frequency = -ENOENT;
+	fds->hw_fifo_watermark = -ENOENT;
+	fds->hw_fifo_flush = -ENOENT;
+	fds->events_num = 0;
+}
+
+int device_iio_utils::enable_sensor(struct device_iio_sysfs_fds *fds,
+				    bool enable)
+{
+	unsigned int i;
+	int err;
+
+	/* same as path based version: buffer enable result is not checked */
+	if (fds->buffer_enable >= 0)
+		sysfs_pwrite_uint(fds->buffer_enable, enable);
+
+	for (i = 0; i < fds->events_num; i++) {
+		err = sysfs_pwrite_uint(fds->events_enable[i], enable);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+int device_iio_utils::set_sampling_frequency(struct device_iio_sysfs_fds *fds,
+					     unsigned int frequency)
+{
+	/* it's ok if file not exists */
+	if (fds->sampling_frequency == -ENOENT)
+		return 0;
+
+	if (fds->sampling_frequency < 0)
+		return fds->sampling_frequency;
+
+	return sysfs_pwrite_uint(fds->sampling_frequency, frequency);
+}
+
+int device_iio_utils::set_hw_fifo_watermark(struct device_iio_sysfs_fds *fds,
+					    unsigned int watermark)
+{
+	/* it's ok if file not exists */
+	if (fds->hw_fifo_watermark == -ENOENT)
+		return 0;
+
+	if (fds->hw_fifo_watermark < 0)
+		return fds->hw_fifo_watermark;
+
+	return sysfs_pwrite_uint(fds->hw_fifo_watermark, watermark);
+}
+
+int device_iio_utils::hw_fifo_flush(struct device_iio_sysfs_fds *fds)
+{
+	/* it's ok if file not exists */
+	if (fds->hw_fifo_flush == -ENOENT)
+		return 0;
+
+	if (fds->hw_fifo_flush < 0)
+		return fds->hw_fifo_flush;
+
+	return sysfs_pwrite_uint(fds->hw_fifo_flush, 1);
+}
+
+/**
+ * write_sysfs_config() - Write attributes that differ from current state
+ * @fds: file descriptors.
+ * @config: values to write, unknown values are not written.
+ *
+ * Attributes are written in the order required by the drivers: buffer
+ * is stopped before, and started after, odr and watermark changes.
+ *
+ * Return value: 0 on success, negative errno on first failure.
+ **/
+int device_iio_utils::write_sysfs_config(struct device_iio_sysfs_fds *fds,
+					 const struct device_iio_sysfs_config *config)
+{
+	struct device_iio_sysfs_config *cur = &fds->current;
+	int err;
+
+	if ((config->buffer_enable == 0) && (cur->buffer_enable != 0)) {
+		err = enable_sensor(fds, false);
+		if (err < 0)
+			return err;
+
+		cur->buffer_enable = 0;
+	}
+
+	if ((config->sampling_frequency != DEVICE_IIO_SYSFS_VALUE_UNKNOWN) &&
+	    (config->sampling_frequency != cur->sampling_frequency)) {
+		err = set_sampling_frequency(fds, config->sampling_frequency);
+		if (err < 0)
+			return err;
+
+		cur->sampling_frequency = config->sampling_frequency;
+	}
+
+	if ((config->hw_fifo_watermark != DEVICE_IIO_SYSFS_VALUE_UNKNOWN) &&
+	    (config->hw_fifo_watermark != cur->hw_fifo_watermark)) {
+		err = set_hw_fifo_watermark(fds, config->hw_fifo_watermark);
+		if (err < 0)
+			return err;
+
+		cur->hw_fifo_watermark = config->hw_fifo_watermark;
+	}
+
+	if ((config->buffer_enable == 1) && (cur->buffer_enable != 1)) {
+		err = enable_sensor(fds, true);
+		if (err < 0)
+			return err;
+
+		cur->buffer_enable = 1;
+	}
+
+	return 0;
+}
+
+/**
+ * apply_sysfs_config() - Move iio device to target configuration
+ * @fds: file descriptors.
+ * @target: target configuration.
+ *
+ * Only attributes whose value changes are written. A stopped device
+ * only needs buffer/enable: odr and watermark changes are collected and
+ * written just before the next buffer enable, so a burst of batch()
+ * calls preceding activate() costs one write per attribute. If a write
+ * fails, attributes already changed are restored to the old values.
+ *
+ * Return value: 0 on success, negative errno on fail.
+ **/
+int device_iio_utils::apply_sysfs_config(struct device_iio_sysfs_fds *fds,
+					 const struct device_iio_sysfs_config *target)
+{
+	struct device_iio_sysfs_config old, config;
+	int err;
+
+	memcpy(&config, target, sizeof(config));
+	if (config.buffer_enable == 0) {
+		config.sampling_frequency = DEVICE_IIO_SYSFS_VALUE_UNKNOWN;
+		config.hw_fifo_watermark = DEVICE_IIO_SYSFS_VALUE_UNKNOWN;
+	}
+
+	memcpy(&old, &fds->current, sizeof(old));
+
+	err = write_sysfs_config(fds, &config);
+	if (err < 0) {
+		if (write_sysfs_config(fds, &old) < 0)
+			ALOGE("Failed to restore iio device configuration.");
+	}
+
+	return err;
+}
+
 int device_iio_utils::set_scale(const char *device_dir,
 				float value,
 				device_iio_chan_type_t device_type)
@@ -788,10 +1370,7 @@ int device_iio_utils::get_type(struct device_iio_info_channel *channel,
 {
 	DIR *dp;
 	int ret;
-	FILE *sysfsfp;
-	unsigned int padint;
 	const struct dirent *ent;
-	char signchar, endianchar;
 	char dir[DEVICE_IIO_MAX_FILENAME_LEN + 1];
 	char type_name[DEVICE_IIO_MAX_FILENAME_LEN + 1];
 	char name_pre_name[DEVICE_IIO_MAX_FILENAME_LEN + 1];
@@ -822,33 +1401,7 @@ int device_iio_utils::get_type(struct device_iio_info_channel *channel,
 		if ((strcmp(type_name, ent->d_name) == 0) ||
 		    (strcmp(name_pre_name, ent->d_name) == 0)) {
 			sprintf(filename, "%s/%s", dir, ent->d_name);
-			sysfsfp = fopen(filename, "r");
-			if (sysfsfp == NULL)
-				continue;
-
-			/* scan format like "le:s16/16>>0" */
-			ret = fscanf(sysfsfp, "%ce:%c%u/%u>>%u",
-				     &endianchar,
-				     &signchar,
-				     &channel->bits_used,
-				     &padint,
-				     &channel->shift);
-			if (ret < 0) {
-				fclose(sysfsfp);
-
-				continue;
-			}
-
-			channel->be = (endianchar == 'b');
-			channel->sign = (signchar == 's');
-			channel->bytes = (padint >> 3);
-
-			if (channel->bits_used == 64)
-				channel->mask = ~0;
-			else
-				channel->mask = (1 << channel->bits_used) - 1;
-
-			fclose(sysfsfp);
+			device_iio_read_type(filename, channel);
 		}
 	}
 
@@ -864,7 +1417,7 @@ int device_iio_utils::get_available_scales(const char *device_dir,
 	int err = 0;
 	FILE *fp;
 	char *avl_name;
-	char *pch;
+	char *pch, *saveptr;
 	char tmp_name[DEVICE_IIO_MAX_FILENAME_LEN + 1];
 	char line[DEVICE_IIO_MAX_FILENAME_LEN + 1];
 
@@ -914,10 +1467,10 @@ int device_iio_utils::get_available_scales(const char *device_dir,
 		goto fpclose;
 	}
 
-	pch = strtok(line," ");
+	pch = strtok_r(line, " ", &saveptr);
 	while (pch != NULL) {
 		sa->scales[sa->length] = atof(pch);
-		pch = strtok(NULL, " ");
+		pch = strtok_r(NULL, " ", &saveptr);
 		sa->length++;
 
 		if (sa->length >= DEVICE_IIO_SCALE_AVAILABLE)
@@ -1033,7 +1586,7 @@ int device_iio_utils::get_selftest_available(const char *device_dir,
 {
 	FILE *fp;
 	int err, elements = 0;
-	char *pch, *res, line[200];
+	char *pch, *res, *saveptr, line[200];
 	char sf_filaname[DEVICE_IIO_MAX_FILENAME_LEN];
 
 	err = sprintf(sf_filaname, "%s/%s", device_dir,
@@ -1051,10 +1604,10 @@ int device_iio_utils::get_selftest_available(const char *device_dir,
 		goto close_file;
 	}
 
-	pch = strtok(line," ,.");
+	pch = strtok_r(line, " ,.", &saveptr);
 	while (pch != NULL) {
 		memcpy(list[elements], pch, strlen(pch) + 1);
-		pch = strtok(NULL, " ,.");
+		pch = strtok_r(NULL, " ,.", &saveptr);
 		elements++;
 	}
 
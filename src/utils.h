@@ -20,6 +20,7 @@
 #define __DEVICE_IIO_UTILS
 
 #include <stdint.h>
+#include <limits.h>
 #include <dirent.h>
 #include <sys/ioctl.h>
 #include <linux/ioctl.h>
@@ -32,6 +33,8 @@
 #define DEVICE_IIO_MAX_SAMPLINGFREQ_LENGTH	32
 #define DEVICE_IIO_MAX_SAMP_FREQ_AVAILABLE	10
 #define DEVICE_IIO_SCALE_AVAILABLE		10
+#define DEVICE_IIO_MAX_EVENT_FDS		8
+#define DEVICE_IIO_SYSFS_VALUE_UNKNOWN		UINT_MAX
 
 /*
  * To fill values for following define please refer to
@@ -108,6 +111,32 @@ struct device_iio_type_name {
 	char name[DEVICE_IIO_MAX_FILENAME_LEN];
 };
 
+/*
+ * Runtime configuration of iio device, DEVICE_IIO_SYSFS_VALUE_UNKNOWN
+ * means the value has never been written (driver default).
+ */
+struct device_iio_sysfs_config {
+	unsigned int buffer_enable;
+	unsigned int sampling_frequency;
+	unsigned int hw_fifo_watermark;
+};
+
+/*
+ * Attributes written at runtime (enable, odr, batch, flush) are kept
+ * open for the whole life of the sensor: fd < 0 is the negative errno
+ * returned by open(), -ENOENT means the attribute is not supported.
+ * current holds the values successfully written to the device.
+ */
+struct device_iio_sysfs_fds {
+	int buffer_enable;
+	int sampling_frequency;
+	int hw_fifo_watermark;
+	int hw_fifo_flush;
+	int events_enable[DEVICE_IIO_MAX_EVENT_FDS];
+	unsigned int events_num;
+	struct device_iio_sysfs_config current;
+};
+
 class device_iio_utils {
 	private:
 		static int sysfs_opendir(const char *name, DIR **dp);
@@ -120,12 +149,17 @@ class device_iio_utils {
 		static int sysfs_read_str(char *file, char *str, int len);
 		static int sysfs_read_float(char *file, float *val);
 		static int check_file(char *filename);
+		static int sysfs_open_attr(const char *device_dir,
+					   const char *attr);
+		static int sysfs_pwrite_uint(int fd, unsigned int val);
+		static int write_sysfs_config(struct device_iio_sysfs_fds *fds,
+					      const struct device_iio_sysfs_config *config);
 		static int enable_events(const char *device_dir,
 					bool enable);
-		static int sysfs_enable_channels(const char *device_dir,
-						 bool enable);
 
 	public:
+		static int sysfs_enable_channels(const char *device_dir,
+						 bool enable);
 		static int get_device_by_name(const char *name);
 		static int enable_sensor(char *device_dir, bool enable);
 		static int get_sampling_frequency_available(char *device_dir,
@@ -138,6 +172,18 @@ class device_iio_utils {
 		static int set_hw_fifo_watermark(char *device_dir,
 						 unsigned int watermark);
 		static int hw_fifo_flush(char *device_dir);
+		static int open_sysfs_fds(const char *device_dir,
+					  struct device_iio_sysfs_fds *fds);
+		static void close_sysfs_fds(struct device_iio_sysfs_fds *fds);
+		static int enable_sensor(struct device_iio_sysfs_fds *fds,
+					 bool enable);
+		static int set_sampling_frequency(struct device_iio_sysfs_fds *fds,
+						  unsigned int frequency);
+		static int set_hw_fifo_watermark(struct device_iio_sysfs_fds *fds,
+						 unsigned int watermark);
+		static int hw_fifo_flush(struct device_iio_sysfs_fds *fds);
+		static int apply_sysfs_config(struct device_iio_sysfs_fds *fds,
+					      const struct device_iio_sysfs_config *target);
 		static int set_scale(const char *device_dir, float value,
 				     device_iio_chan_type_t device_type);
 		static int get_scale(const char *device_dir, float *value,
@@ -153,6 +199,19 @@ class device_iio_utils {
 		static int scan_channel(const char *device_dir,
 					struct device_iio_info_channel **ci_array,
 					int *counter);
+		static int get_attributes_hash(const char *device_dir,
+					       uint32_t *hash);
+		static int enable_channel(const char *device_dir,
+					  const char *name, bool enable);
+		static int check_channel(const char *device_dir,
+					 const struct device_iio_info_channel *channel);
+		static bool is_timestamp_channel(const struct device_iio_info_channel *channel);
+		static int select_channels(const char *device_dir,
+					   struct device_iio_info_channel *channels,
+					   int *num_channels, int data_channels,
+					   bool enable_used);
+		static int get_scan_size(struct device_iio_info_channel *channels,
+					 int num_channels);
 		static int support_injection_mode(const char *device_dir);
 		static int set_injection_mode(const char *device_dir, bool enable);
 		static int inject_data(const char *device_dir, unsigned char *data,
@@ -0,0 +1,172 @@
+#
+# Copyright (C) 2015-2016 STMicroelectronics
+# Denis Ciocca - Motion MEMS Product Div.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#/
+
+ifneq ($(TARGET_SIMULATOR),true)
+
+LOCAL_PATH := $(call my-dir)
+ST_HAL_SRC_PATH := $(LOCAL_PATH)/../src
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_OWNER := STMicroelectronics
+
+LOCAL_C_INCLUDES := $(ST_HAL_SRC_PATH)
+
+LOCAL_SRC_FILES := \
+		../src/FlushCoalescer.cpp \
+		../src/DirectChannelPlanner.cpp \
+		../src/ChangeODRTimestampStack.cpp \
+		../src/FlushBufferStack.cpp \
+		FlushCoalescer_test.cpp \
+		DirectChannelPlanner_test.cpp \
+		ControlStack_test.cpp
+
+LOCAL_CPPFLAGS := \
+		-std=gnu++11 \
+		-W -Wall -Wextra
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := STSensorHAL_tests
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_OWNER := STMicroelectronics
+
+LOCAL_C_INCLUDES := $(ST_HAL_SRC_PATH)
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+
+LOCAL_SRC_FILES := \
+		../src/EventRingBuffer.cpp \
+		EventRingBuffer_benchmark.cpp
+
+LOCAL_CPPFLAGS := \
+		-std=gnu++11 -O2 \
+		-W -Wall -Wextra
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := STSensorHAL_ringbuffer_benchmark
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_OWNER := STMicroelectronics
+
+LOCAL_C_INCLUDES := $(ST_HAL_SRC_PATH)
+
+LOCAL_SRC_FILES := \
+		../src/RateTable.cpp \
+		ConfigLock_benchmark.cpp
+
+LOCAL_CPPFLAGS := \
+		-std=gnu++11 -O2 \
+		-W -Wall -Wextra
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := STSensorHAL_config_lock_benchmark
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+include $(ST_HAL_SRC_PATH)/../hal_config
+
+LOCAL_MODULE_OWNER := STMicroelectronics
+
+LOCAL_SHARED_LIBRARIES := \
+		libutils \
+		liblog
+
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+
+LOCAL_C_INCLUDES := $(ST_HAL_SRC_PATH) \
+			$(ST_HAL_SRC_PATH)/../
+
+LOCAL_SRC_FILES := \
+		../src/utils.cpp \
+		ScanChannels_benchmark.cpp
+
+LOCAL_CFLAGS += -DLOG_TAG=\"SensorHAL\"
+LOCAL_CPPFLAGS := \
+		-std=gnu++11 -O2 \
+		-W -Wall -Wextra
+
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := STSensorHAL_scan_channels_benchmark
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+include $(ST_HAL_SRC_PATH)/../hal_config
+
+ifdef CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+LOCAL_MODULE_OWNER := STMicroelectronics
+
+LOCAL_SHARED_LIBRARIES := \
+		libcutils \
+		libutils \
+		liblog
+
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+
+LOCAL_C_INCLUDES := $(ST_HAL_SRC_PATH) \
+			$(ST_HAL_SRC_PATH)/../
+
+LOCAL_SRC_FILES := \
+		../src/CircularBuffer.cpp \
+		../src/FlushBufferStack.cpp \
+		../src/ChangeODRTimestampStack.cpp \
+		../src/SensorOutputPipe.cpp \
+		../src/SensorOutputTap.cpp \
+		../src/RateTable.cpp \
+		../src/HandleBitmap.cpp \
+		../src/SensorBase.cpp \
+		../src/SWSensorBase.cpp \
+		IdleThreads_benchmark.cpp
+
+ifdef CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+LOCAL_SHARED_LIBRARIES += libstagefright_foundation
+LOCAL_HEADER_LIBRARIES += libstagefright_foundation_headers
+LOCAL_SRC_FILES += ../src/RingBuffer.cpp
+LOCAL_SRC_FILES += ../src/EventRingBuffer.cpp
+LOCAL_SRC_FILES += ../src/DirectChannelPlanner.cpp
+endif # CONFIG_ST_HAL_DIRECT_REPORT_SENSOR
+
+ifdef CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED
+LOCAL_SRC_FILES += ../src/SensorAdditionalInfo.cpp
+endif # CONFIG_ST_HAL_ADDITIONAL_INFO_ENABLED
+
+LOCAL_CFLAGS += -DLOG_TAG=\"SensorHAL\"
+LOCAL_CPPFLAGS := \
+		-std=gnu++11 -O2 \
+		-W -Wall -Wextra
+
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := STSensorHAL_idle_threads_benchmark
+
+include $(BUILD_EXECUTABLE)
+endif # CONFIG_ST_HAL_LAZY_THREADS_ENABLED
+
+endif # !TARGET_SIMULATOR
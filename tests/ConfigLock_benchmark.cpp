@@ -0,0 +1,196 @@
+/*
+ * STMicroelectronics configuration lock contention benchmark
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#define __STDC_LIMIT_MACROS
+#define __STDINT_LIMITS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "RateTable.h"
+#include "LockFreeQueue.h"
+#include "benchmark_utils.h"
+
+#define MAX_DEPS		(3)
+#define DATA_QUEUE_LEN		(32)
+
+/*
+ * Sensors graph of a 6-axis + magnetometer device: activate/batch of a
+ * virtual sensor updates the rate table of every sensor below it.
+ */
+struct graph_node {
+	const char *name;
+	int deps[MAX_DEPS];
+	int num_deps;
+	bool hw;
+	RateTable rates;
+	pthread_mutex_t enable_mutex;
+};
+
+static struct graph_node graph[] = {
+	{ "accel", { 0 }, 0, true, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "magn", { 0 }, 0, true, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "gyro", { 0 }, 0, true, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "fusion6X", { 0, 2 }, 2, false, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "fusion9X", { 0, 1, 2 }, 3, false, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "game_rv", { 3 }, 1, false, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "rv", { 4 }, 1, false, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "gravity", { 3 }, 1, false, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "linear_accel", { 3 }, 1, false, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+	{ "gyro_uncalib", { 2 }, 1, false, RateTable(), PTHREAD_MUTEX_INITIALIZER },
+};
+
+#define GRAPH_NODES		((int)(sizeof(graph) / sizeof(graph[0])))
+
+static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int sysfs_write_us;
+static int ops_per_thread = 20000;
+
+struct odr_change {
+	int64_t timestamp;
+	int64_t period;
+};
+
+static LockFreeQueue<odr_change, DATA_QUEUE_LEN> odr_queue;
+
+/* simulated sysfs write of sampling_frequency/hwfifo_watermark */
+static void write_sysfs(void)
+{
+	if (sysfs_write_us > 0)
+		usleep(sysfs_write_us);
+}
+
+static void apply(int node, int consumer, int64_t period, int64_t timeout,
+		  bool nested_locks)
+{
+	int i;
+	struct graph_node *n = &graph[node];
+
+	if (nested_locks)
+		pthread_mutex_lock(&n->enable_mutex);
+
+	n->rates.set(consumer, period, timeout);
+	if (n->hw)
+		write_sysfs();
+
+	for (i = 0; i < n->num_deps; i++)
+		apply(n->deps[i], node, n->rates.getMinPeriod(),
+		      n->rates.getMinTimeout(), nested_locks);
+
+	if (nested_locks)
+		pthread_mutex_unlock(&n->enable_mutex);
+}
+
+/* activate/batch entry point as called by android */
+static void batch(int node, int64_t period, int64_t timeout, bool nested_locks)
+{
+	if (!nested_locks)
+		pthread_mutex_lock(&config_mutex);
+
+	apply(node, 1000 + node, period, timeout, nested_locks);
+
+	if (!nested_locks)
+		pthread_mutex_unlock(&config_mutex);
+}
+
+static void config_thread(int id, bool nested_locks)
+{
+	int i, node;
+	unsigned int seed = id;
+
+	for (i = 0; i < ops_per_thread; i++) {
+		node = 3 + (rand_r(&seed) % (GRAPH_NODES - 3));
+		batch(node, (1 + (rand_r(&seed) % 20)) * 1000000LL,
+		      (i & 1) ? 0 : 100000000LL, nested_locks);
+	}
+}
+
+/* data thread: odr change queue push/pop, measured per sample */
+static void data_thread(std::atomic<bool> *stop, bool data_takes_lock,
+			std::vector<int64_t> *lat)
+{
+	int64_t start;
+	struct odr_change c = { 0, 0 };
+
+	while (!stop->load()) {
+		start = bench_now_ns();
+
+		if (data_takes_lock)
+			pthread_mutex_lock(&config_mutex);
+
+		c.timestamp++;
+		odr_queue.push(c);
+		odr_queue.pop(&c);
+
+		if (data_takes_lock)
+			pthread_mutex_unlock(&config_mutex);
+
+		lat->push_back(bench_now_ns() - start);
+	}
+}
+
+static void run(const char *label, int threads, bool nested_locks,
+		bool data_takes_lock)
+{
+	int i;
+	int64_t start, elapsed;
+	std::atomic<bool> stop(false);
+	std::vector<int64_t> lat;
+	std::vector<std::thread> workers;
+
+	lat.reserve(1 << 24);
+	std::thread data(data_thread, &stop, data_takes_lock, &lat);
+
+	start = bench_now_ns();
+	for (i = 0; i < threads; i++)
+		workers.push_back(std::thread(config_thread, i, nested_locks));
+	for (i = 0; i < threads; i++)
+		workers[i].join();
+	elapsed = bench_now_ns() - start;
+
+	stop.store(true);
+	data.join();
+
+	std::sort(lat.begin(), lat.end());
+	printf("%-22s %2d  %9.0f  %9lld  %11lld\n", label, threads,
+	       (double)threads * ops_per_thread * 1E9 / elapsed,
+	       (long long)lat[(lat.size() * 99) / 100],
+	       (long long)lat[(lat.size() * 999) / 1000]);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int t;
+	static const int threads[] = { 1, 2, 4, 8 };
+
+	/* optional simulated sysfs write time: real writes take tens of us */
+	if (argc > 1) {
+		sysfs_write_us = atoi(argv[1]);
+		if (sysfs_write_us > 0)
+			ops_per_thread = 500;
+	}
+
+	printf("sysfs write: %d us\n", sysfs_write_us);
+	printf("%-22s %2s  %9s  %9s  %11s\n", "config lock", "th",
+	       "batch/s", "data p99", "p99.9[ns]");
+
+	for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+		run("nested enable_mutex", threads[t], true, false);
+		run("graph config_mutex", threads[t], false, false);
+		run("config_mutex on data", threads[t], false, true);
+	}
+
+	return 0;
+}
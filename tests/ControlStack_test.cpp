@@ -0,0 +1,138 @@
+/*
+ * STMicroelectronics ODR change and Flush stacks tests
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <gtest/gtest.h>
+
+#include "ChangeODRTimestampStack.h"
+#include "FlushBufferStack.h"
+
+#define BURST_PRODUCERS		4
+#define BURST_FLUSHES		100
+
+struct flush_producer {
+	FlushBufferStack *stack;
+	int handle;
+	unsigned int num;
+	unsigned int failed;
+};
+
+static void *flush_producer_thread(void *arg)
+{
+	unsigned int i;
+	struct flush_producer *p = (struct flush_producer *)arg;
+
+	for (i = 0; i < p->num; i++) {
+		if (p->stack->writeElement(p->handle, i + 1) < 0)
+			p->failed++;
+	}
+
+	return NULL;
+}
+
+TEST(ChangeODRTimestampStackTest, NextTimestampFollowsQueue)
+{
+	int64_t pollrate;
+	ChangeODRTimestampStack odr;
+
+	EXPECT_EQ(INT64_MAX, odr.nextTimestamp());
+
+	ASSERT_EQ(0, odr.writeElement(1000, 10000000));
+	ASSERT_EQ(0, odr.writeElement(2000, 5000000));
+	EXPECT_EQ(1000, odr.nextTimestamp());
+	/* cached value, nothing changed */
+	EXPECT_EQ(1000, odr.nextTimestamp());
+
+	EXPECT_EQ(1000, odr.readLastElement(&pollrate));
+	EXPECT_EQ(10000000, pollrate);
+	odr.removeLastElement();
+	EXPECT_EQ(2000, odr.nextTimestamp());
+
+	odr.resetBuffer();
+	EXPECT_EQ(INT64_MAX, odr.nextTimestamp());
+
+	ASSERT_EQ(0, odr.writeElement(3000, 2500000));
+	EXPECT_EQ(3000, odr.nextTimestamp());
+}
+
+TEST(FlushBufferStackTest, WriteAfterCachedEmptyIsSeen)
+{
+	int64_t timestamp;
+	FlushBufferStack flush;
+
+	EXPECT_EQ(INT64_MAX, flush.nextTimestamp());
+
+	ASSERT_EQ(0, flush.writeElement(7, 500));
+	EXPECT_EQ(500, flush.nextTimestamp());
+	EXPECT_EQ(7, flush.readLastElement(&timestamp));
+	EXPECT_EQ(500, timestamp);
+	flush.removeLastElement();
+	EXPECT_EQ(INT64_MAX, flush.nextTimestamp());
+}
+
+/*
+ * android may send a flush per sensor at once: a burst of 100 from
+ * concurrent producers must fit and be read back exactly once.
+ */
+TEST(FlushBufferStackTest, BurstOf100FlushesNeverOverflows)
+{
+	int handle;
+	int64_t timestamp;
+	unsigned int i, read = 0;
+	unsigned int count[BURST_PRODUCERS] = { 0 };
+	pthread_t threads[BURST_PRODUCERS];
+	struct flush_producer producers[BURST_PRODUCERS];
+	FlushBufferStack flush;
+
+	for (i = 0; i < BURST_PRODUCERS; i++) {
+		producers[i].stack = &flush;
+		producers[i].handle = i;
+		producers[i].num = BURST_FLUSHES / BURST_PRODUCERS;
+		producers[i].failed = 0;
+		ASSERT_EQ(0, pthread_create(&threads[i], NULL,
+					    flush_producer_thread, &producers[i]));
+	}
+
+	/* consumer runs while producers push, like the data thread */
+	while (read < BURST_FLUSHES) {
+		if (flush.nextTimestamp() == INT64_MAX)
+			continue;
+
+		handle = flush.readLastElement(&timestamp);
+		ASSERT_GE(handle, 0);
+		ASSERT_LT(handle, BURST_PRODUCERS);
+		/* every producer stacks its flushes in order */
+		EXPECT_EQ((int64_t)count[handle] + 1, timestamp);
+		count[handle]++;
+		flush.removeLastElement();
+		read++;
+	}
+
+	for (i = 0; i < BURST_PRODUCERS; i++) {
+		pthread_join(threads[i], NULL);
+		EXPECT_EQ(0U, producers[i].failed);
+		EXPECT_EQ(BURST_FLUSHES / BURST_PRODUCERS, count[i]);
+	}
+
+	EXPECT_EQ(INT64_MAX, flush.nextTimestamp());
+	EXPECT_EQ(0U, flush.ElemetsOnStack());
+}
+
+TEST(FlushBufferStackTest, BurstOf100WithoutConsumerFits)
+{
+	unsigned int i;
+	FlushBufferStack flush;
+
+	for (i = 0; i < BURST_FLUSHES; i++)
+		ASSERT_EQ(0, flush.writeElement(i, 1000 + i));
+
+	EXPECT_EQ((unsigned int)BURST_FLUSHES, flush.ElemetsOnStack());
+	EXPECT_EQ(1000, flush.nextTimestamp());
+}
@@ -0,0 +1,167 @@
+/*
+ * STMicroelectronics Direct Channel Planner Class tests
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include <gtest/gtest.h>
+
+#include "DirectChannelPlanner.h"
+
+#define NS_PER_S		(1000000000LL)
+#define MAX_FREQS		(10)
+
+/* SENSOR_DIRECT_RATE_NORMAL, SENSOR_DIRECT_RATE_FAST, SENSOR_DIRECT_RATE_VERY_FAST */
+static const float rate_levels[] = { 50.0f, 200.0f, 800.0f };
+
+/*
+ * sampling_frequency_available exported by ST iio drivers
+ */
+struct freq_table {
+	const char *name;
+	float freq[MAX_FREQS];
+	unsigned int length;
+};
+
+static const struct freq_table st_tables[] = {
+	{ "lsm6ds3/lsm6dsl/lsm6dsm accel+gyro", { 13, 26, 52, 104, 208, 416 }, 6 },
+	{ "lsm6dso/lsm6dsox/asm330lhh accel+gyro", { 12.5f, 26, 52, 104, 208, 416, 833 }, 7 },
+	{ "lsm6dsr/ism330dhcx accel+gyro", { 12.5f, 26, 52, 104, 208, 416, 833, 1666 }, 8 },
+	{ "lsm6dsx accel (hp mode)", { 12.5f, 26, 52, 104, 208, 416, 833, 1666, 3332, 6664 }, 10 },
+	{ "lis3dh/lis2dh12 accel", { 1, 10, 25, 50, 100, 200, 400 }, 7 },
+	{ "lis2dh12 accel (lp mode)", { 1, 10, 25, 50, 100, 200, 400, 1344 }, 8 },
+	{ "lis2dw12 accel", { 12.5f, 25, 50, 100, 200, 400, 800, 1600 }, 8 },
+	{ "lis2ds12 accel", { 12.5f, 25, 50, 100, 200, 400, 800 }, 7 },
+	{ "lsm9ds1 accel+gyro", { 14.9f, 59.5f, 119, 238, 476, 952 }, 6 },
+	{ "l3gd20/l3g4200d gyro", { 95, 190, 380, 760 }, 4 },
+	{ "lis3mdl magn", { 1, 2, 3, 5, 10, 20, 40, 80 }, 8 },
+	{ "lis2mdl/lsm303agr magn", { 10, 20, 50, 100 }, 4 },
+	{ "lps22hb pressure", { 1, 10, 25, 50, 75 }, 5 },
+};
+
+static int64_t level_period(float rate)
+{
+	return (int64_t)(1E9 / rate);
+}
+
+static bool table_has_period(const struct freq_table *t, int64_t period)
+{
+	unsigned int i;
+
+	for (i = 0; i < t->length; i++) {
+		if ((int64_t)(1E9 / t->freq[i]) == period)
+			return true;
+	}
+
+	return false;
+}
+
+/* rate level reachable: stream can be decimated down into the band */
+static bool level_reachable(const struct freq_table *t, float rate)
+{
+	return t->freq[t->length - 1] >= (ST_DIRECT_RATE_MIN_RATIO * rate);
+}
+
+static void expect_in_band(const char *name, float rate,
+			   int64_t stream_period, unsigned int decimation)
+{
+	double effective = (double)NS_PER_S / ((double)stream_period * decimation);
+
+	EXPECT_GE(decimation, 1U) << name << " @" << rate << "Hz";
+	EXPECT_GE(effective, ST_DIRECT_RATE_MIN_RATIO * rate * 0.9999)
+		<< name << " @" << rate << "Hz: stream " << stream_period
+		<< "ns, decimation " << decimation;
+	EXPECT_LE(effective, ST_DIRECT_RATE_MAX_RATIO * rate * 1.0001)
+		<< name << " @" << rate << "Hz: stream " << stream_period
+		<< "ns, decimation " << decimation;
+}
+
+TEST(DirectChannelPlannerTest, SingleChannelInBand)
+{
+	const struct freq_table *t;
+	int64_t period, stream_period;
+	unsigned int i, l;
+
+	for (i = 0; i < sizeof(st_tables) / sizeof(st_tables[0]); i++) {
+		t = &st_tables[i];
+
+		for (l = 0; l < sizeof(rate_levels) / sizeof(rate_levels[0]); l++) {
+			period = level_period(rate_levels[l]);
+			stream_period = DirectChannelPlanner::planPeriod(period,
+								t->freq, t->length);
+			EXPECT_TRUE(table_has_period(t, stream_period))
+				<< t->name << " @" << rate_levels[l] << "Hz";
+
+			if (!level_reachable(t, rate_levels[l])) {
+				/* sensor too slow: runs at its fastest odr */
+				EXPECT_EQ(stream_period,
+					  (int64_t)(1E9 / t->freq[t->length - 1]))
+					<< t->name << " @" << rate_levels[l] << "Hz";
+				continue;
+			}
+
+			expect_in_band(t->name, rate_levels[l], stream_period,
+				DirectChannelPlanner::decimation(period, stream_period));
+		}
+	}
+}
+
+TEST(DirectChannelPlannerTest, SharedStreamInBand)
+{
+	const struct freq_table *t;
+	int64_t period, stream_period;
+	unsigned int i, l, n;
+
+	/* channels at every reachable level share the fastest planned stream */
+	for (i = 0; i < sizeof(st_tables) / sizeof(st_tables[0]); i++) {
+		t = &st_tables[i];
+
+		for (n = 1; n <= sizeof(rate_levels) / sizeof(rate_levels[0]); n++) {
+			stream_period = INT64_MAX;
+
+			for (l = 0; l < n; l++) {
+				if (!level_reachable(t, rate_levels[l]))
+					break;
+
+				period = DirectChannelPlanner::planPeriod(
+						level_period(rate_levels[l]),
+						t->freq, t->length);
+				if (period < stream_period)
+					stream_period = period;
+			}
+
+			if (l < n)
+				continue;
+
+			for (l = 0; l < n; l++) {
+				period = level_period(rate_levels[l]);
+				expect_in_band(t->name, rate_levels[l], stream_period,
+					DirectChannelPlanner::decimation(period, stream_period));
+			}
+		}
+	}
+}
+
+TEST(DirectChannelPlannerTest, Decimation)
+{
+	/* 833Hz stream: 50Hz level decimated by 17 (49Hz) */
+	EXPECT_EQ(17U, DirectChannelPlanner::decimation(level_period(50),
+							level_period(833)));
+
+	/* stream slower than or equal to nominal rate is never decimated */
+	EXPECT_EQ(1U, DirectChannelPlanner::decimation(level_period(200),
+						       level_period(104)));
+	EXPECT_EQ(1U, DirectChannelPlanner::decimation(level_period(50), 0));
+}
+
+TEST(DirectChannelPlannerTest, NoTable)
+{
+	float freq[1] = { 0 };
+
+	/* sensors without sampling_frequency_available run at nominal period */
+	EXPECT_EQ(level_period(200),
+		  DirectChannelPlanner::planPeriod(level_period(200), freq, 0));
+}
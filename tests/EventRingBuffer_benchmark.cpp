@@ -0,0 +1,136 @@
+/*
+ * STMicroelectronics Event Ring Buffer benchmark
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "EventRingBuffer.h"
+#include "benchmark_utils.h"
+
+/* direct channel memory as allocated by android (ashmem, 104 bytes events) */
+#define CHANNEL_EVENTS		(1000)
+#define TOTAL_EVENTS		(4000000)
+#define RUNS			(5)
+
+static inline void bench_min(int64_t *min, int64_t v)
+{
+	if (v < *min)
+		*min = v;
+}
+
+/*
+ * legacy_write - per event write used before batching (no ordering
+ * between event copy and counter stamping), not inlined: a call as
+ * RingBuffer::write()
+ */
+static __attribute__((noinline))
+void legacy_write(sensors_event_t *data, size_t len, size_t *pos,
+		  int32_t *counter, const sensors_event_t *ev, size_t size)
+{
+	while (size--) {
+		data[*pos] = *(ev++);
+		data[*pos].reserved0 = (*counter)++;
+
+		if (++(*pos) >= len)
+			*pos = 0;
+	}
+}
+
+static void *map_channel(size_t size)
+{
+	int fd;
+	void *mem;
+
+	/* memfd stands in for ashmem on host */
+	fd = syscall(SYS_memfd_create, "direct_channel", 0);
+	if (fd < 0)
+		return NULL;
+
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return (mem == MAP_FAILED) ? NULL : mem;
+}
+
+int main(void)
+{
+	void *mem;
+	size_t pos = 0, i, j, n, r;
+	int32_t counter = 1;
+	int64_t start, legacy_ns, single_ns, batch_ns;
+	sensors_event_t events[256];
+	static const size_t batch_sizes[] = { 1, 4, 8, 16, 32, 128, 256 };
+	size_t size = CHANNEL_EVENTS * sizeof(sensors_event_t);
+
+	mem = map_channel(size);
+	if (!mem) {
+		perror("map_channel");
+		return 1;
+	}
+
+	memset(events, 0, sizeof(events));
+	for (i = 0; i < 256; i++) {
+		events[i].sensor = 1;
+		events[i].type = 1;
+		events[i].timestamp = i * 1200000LL;
+		events[i].data[0] = (float)i;
+	}
+
+	printf("batch  legacy[ns/ev]  write(1)[ns/ev]  write(batch)[ns/ev]\n");
+
+	for (n = 0; n < sizeof(batch_sizes) / sizeof(batch_sizes[0]); n++) {
+		RingBuffer *rb = new RingBuffer(mem, size);
+
+		legacy_ns = single_ns = batch_ns = INT64_MAX;
+
+		for (r = 0; r < RUNS; r++) {
+			start = bench_now_ns();
+			for (i = 0; i < TOTAL_EVENTS; i += batch_sizes[n])
+				legacy_write((sensors_event_t *)mem, CHANNEL_EVENTS, &pos,
+					     &counter, events, batch_sizes[n]);
+			bench_clobber(mem);
+			bench_min(&legacy_ns, bench_now_ns() - start);
+
+			start = bench_now_ns();
+			for (i = 0, j = 0; i < TOTAL_EVENTS; i++) {
+				rb->write(&events[j], 1);
+				if (++j == batch_sizes[n])
+					j = 0;
+			}
+			bench_clobber(mem);
+			bench_min(&single_ns, bench_now_ns() - start);
+
+			start = bench_now_ns();
+			for (i = 0; i < TOTAL_EVENTS; i += batch_sizes[n])
+				rb->write(events, batch_sizes[n]);
+			bench_clobber(mem);
+			bench_min(&batch_ns, bench_now_ns() - start);
+		}
+
+		printf("%5zu  %13.2f  %15.2f  %19.2f\n", batch_sizes[n],
+		       (double)legacy_ns / TOTAL_EVENTS,
+		       (double)single_ns / TOTAL_EVENTS,
+		       (double)batch_ns / TOTAL_EVENTS);
+
+		delete rb;
+	}
+
+	munmap(mem, size);
+
+	return 0;
+}
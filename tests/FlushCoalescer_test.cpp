@@ -0,0 +1,270 @@
+/*
+ * STMicroelectronics Flush Coalescer Class tests
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "FlushCoalescer.h"
+
+#define ACCEL_HANDLE		1
+#define GYRO_HANDLE		2
+#define GAME_ROT_HANDLE		10
+#define ROT_VECTOR_HANDLE	11
+#define GRAVITY_HANDLE		12
+
+struct completion {
+	int device;
+	int handle;
+	int64_t timestamp;
+};
+
+/*
+ * mock_device - iio device, hw_fifo_flush() is counted instead of written
+ */
+struct mock_device {
+	int id;
+	unsigned int hw_flush_count;
+	int hw_flush_err;
+	std::vector<struct completion> *completed;
+};
+
+static int mock_hw_fifo_flush(void *ctx)
+{
+	struct mock_device *dev = (struct mock_device *)ctx;
+
+	if (dev->hw_flush_err < 0)
+		return dev->hw_flush_err;
+
+	dev->hw_flush_count++;
+
+	return 0;
+}
+
+static void mock_flush_complete(void *ctx, int handle, int64_t timestamp)
+{
+	struct mock_device *dev = (struct mock_device *)ctx;
+	struct completion c = { dev->id, handle, timestamp };
+
+	dev->completed->push_back(c);
+}
+
+class FlushCoalescerTest : public ::testing::Test {
+protected:
+	FlushCoalescer fifo;
+	struct mock_device accel, gyro;
+	std::vector<struct completion> completed;
+
+	virtual void SetUp() {
+		accel = { 0, 0, 0, &completed };
+		gyro = { 0, 0, 0, &completed };
+
+		accel.id = fifo.addDevice(&accel, mock_hw_fifo_flush, mock_flush_complete);
+		gyro.id = fifo.addDevice(&gyro, mock_hw_fifo_flush, mock_flush_complete);
+		ASSERT_EQ(0, accel.id);
+		ASSERT_EQ(1, gyro.id);
+	}
+
+	/* framework flushes accel, gyro and three 6X fusion sensors at once */
+	void FlushBurst(int64_t now) {
+		static const int fusion_handles[] = {
+			GAME_ROT_HANDLE, ROT_VECTOR_HANDLE, GRAVITY_HANDLE
+		};
+		unsigned int i;
+
+		EXPECT_LE(0, fifo.request(accel.id, ACCEL_HANDLE, now));
+		EXPECT_LE(0, fifo.request(gyro.id, GYRO_HANDLE, now));
+
+		for (i = 0; i < sizeof(fusion_handles) / sizeof(fusion_handles[0]); i++) {
+			EXPECT_LE(0, fifo.request(accel.id, fusion_handles[i], now));
+			EXPECT_LE(0, fifo.request(gyro.id, fusion_handles[i], now));
+		}
+	}
+
+	/* flush complete event reported by the device written */
+	void CompleteWrite(int64_t timestamp) {
+		if (accel.hw_flush_count > gyro.hw_flush_count)
+			fifo.complete(accel.id, timestamp, timestamp);
+		else
+			fifo.complete(gyro.id, timestamp, timestamp);
+	}
+
+	unsigned int HWFlushCount() {
+		return accel.hw_flush_count + gyro.hw_flush_count;
+	}
+};
+
+TEST_F(FlushCoalescerTest, BurstOnSharedFifoCostsTwoHWFlushes)
+{
+	int64_t now = 1000;
+	unsigned int burst;
+
+	for (burst = 1; burst <= 3; burst++) {
+		completed.clear();
+		FlushBurst(now);
+
+		/* first request writes, the other ones wait for it */
+		EXPECT_EQ(2 * burst - 1, HWFlushCount());
+
+		/* completion re-issues one write for the whole burst */
+		fifo.complete(accel.id, now + 10, now + 10);
+		EXPECT_EQ(2 * burst, HWFlushCount());
+		ASSERT_EQ(1u, completed.size());
+		EXPECT_EQ(ACCEL_HANDLE, completed[0].handle);
+
+		CompleteWrite(now + 20);
+		EXPECT_EQ(2 * burst, HWFlushCount());
+		EXPECT_EQ(8u, completed.size());
+		EXPECT_EQ(2 * burst, fifo.getHWFlushCount());
+
+		now += 1000;
+	}
+}
+
+TEST_F(FlushCoalescerTest, CompletionsInRequestOrder)
+{
+	std::vector<struct completion> expected;
+	unsigned int i;
+
+	FlushBurst(1000);
+	fifo.complete(accel.id, 1010, 1010);
+	CompleteWrite(1020);
+
+	ASSERT_EQ(8u, completed.size());
+	expected.push_back({ accel.id, ACCEL_HANDLE, 1010 });
+	expected.push_back({ gyro.id, GYRO_HANDLE, 1020 });
+	expected.push_back({ accel.id, GAME_ROT_HANDLE, 1020 });
+	expected.push_back({ gyro.id, GAME_ROT_HANDLE, 1020 });
+	expected.push_back({ accel.id, ROT_VECTOR_HANDLE, 1020 });
+	expected.push_back({ gyro.id, ROT_VECTOR_HANDLE, 1020 });
+	expected.push_back({ accel.id, GRAVITY_HANDLE, 1020 });
+	expected.push_back({ gyro.id, GRAVITY_HANDLE, 1020 });
+
+	for (i = 0; i < expected.size(); i++) {
+		EXPECT_EQ(expected[i].device, completed[i].device);
+		EXPECT_EQ(expected[i].handle, completed[i].handle);
+		EXPECT_EQ(expected[i].timestamp, completed[i].timestamp);
+	}
+}
+
+TEST_F(FlushCoalescerTest, RequestAfterWriteNotCompletedByIt)
+{
+	EXPECT_EQ(1, fifo.request(accel.id, ACCEL_HANDLE, 1000));
+	EXPECT_EQ(0, fifo.request(accel.id, GAME_ROT_HANDLE, 1001));
+
+	fifo.complete(accel.id, 1010, 1010);
+	ASSERT_EQ(1u, completed.size());
+	EXPECT_EQ(ACCEL_HANDLE, completed[0].handle);
+	EXPECT_EQ(2u, accel.hw_flush_count);
+
+	fifo.complete(accel.id, 1020, 1020);
+	ASSERT_EQ(2u, completed.size());
+	EXPECT_EQ(GAME_ROT_HANDLE, completed[1].handle);
+	EXPECT_EQ(1020, completed[1].timestamp);
+}
+
+TEST_F(FlushCoalescerTest, LostCompletionWrittenAgainAfterTimeout)
+{
+	EXPECT_EQ(1, fifo.request(accel.id, ACCEL_HANDLE, 1000));
+
+	/* flush complete event never comes */
+	EXPECT_EQ(0, fifo.request(accel.id, ACCEL_HANDLE, 1000 + ST_FLUSH_COALESCER_TIMEOUT_NS - 1));
+	EXPECT_EQ(1u, accel.hw_flush_count);
+
+	EXPECT_EQ(1, fifo.request(accel.id, ACCEL_HANDLE, 1000 + ST_FLUSH_COALESCER_TIMEOUT_NS));
+	EXPECT_EQ(2u, accel.hw_flush_count);
+
+	/* new write covers requests of the lost one */
+	fifo.complete(accel.id, 5000, 5000);
+	EXPECT_EQ(3u, completed.size());
+	EXPECT_EQ(2u, accel.hw_flush_count);
+}
+
+TEST_F(FlushCoalescerTest, CompletionOfDeviceNotWrittenIgnored)
+{
+	EXPECT_EQ(1, fifo.request(accel.id, ACCEL_HANDLE, 1000));
+
+	fifo.complete(gyro.id, 1010, 1010);
+	EXPECT_EQ(0u, completed.size());
+
+	fifo.complete(accel.id, 1020, 1020);
+	EXPECT_EQ(1u, completed.size());
+
+	/* nothing in flight */
+	fifo.complete(accel.id, 1030, 1030);
+	EXPECT_EQ(1u, completed.size());
+}
+
+TEST_F(FlushCoalescerTest, CancelWriteDeviceReissuesForSibling)
+{
+	EXPECT_EQ(1, fifo.request(accel.id, ACCEL_HANDLE, 1000));
+	EXPECT_EQ(0, fifo.request(gyro.id, GYRO_HANDLE, 1000));
+	EXPECT_EQ(0, fifo.request(accel.id, GAME_ROT_HANDLE, 1000));
+
+	/* accel disabled: its requests complete now, gyro one is written */
+	fifo.cancel(accel.id, 1005);
+	EXPECT_EQ(1u, gyro.hw_flush_count);
+	ASSERT_EQ(2u, completed.size());
+	EXPECT_EQ(ACCEL_HANDLE, completed[0].handle);
+	EXPECT_EQ(GAME_ROT_HANDLE, completed[1].handle);
+	EXPECT_EQ(0, completed[1].timestamp);
+
+	fifo.complete(gyro.id, 1010, 1010);
+	ASSERT_EQ(3u, completed.size());
+	EXPECT_EQ(GYRO_HANDLE, completed[2].handle);
+	EXPECT_EQ(1010, completed[2].timestamp);
+	EXPECT_EQ(2u, HWFlushCount());
+}
+
+TEST_F(FlushCoalescerTest, CancelOtherDeviceKeepsWriteInFlight)
+{
+	EXPECT_EQ(1, fifo.request(accel.id, ACCEL_HANDLE, 1000));
+	EXPECT_EQ(0, fifo.request(gyro.id, GYRO_HANDLE, 1000));
+
+	fifo.cancel(gyro.id, 1005);
+	ASSERT_EQ(1u, completed.size());
+	EXPECT_EQ(gyro.id, completed[0].device);
+	EXPECT_EQ(GYRO_HANDLE, completed[0].handle);
+	EXPECT_EQ(1u, HWFlushCount());
+
+	fifo.complete(accel.id, 1010, 1010);
+	ASSERT_EQ(2u, completed.size());
+	EXPECT_EQ(ACCEL_HANDLE, completed[1].handle);
+	EXPECT_EQ(1u, HWFlushCount());
+}
+
+TEST_F(FlushCoalescerTest, WriteFailureNotQueued)
+{
+	accel.hw_flush_err = -EIO;
+	EXPECT_EQ(-EIO, fifo.request(accel.id, ACCEL_HANDLE, 1000));
+
+	accel.hw_flush_err = 0;
+	EXPECT_EQ(1, fifo.request(accel.id, GAME_ROT_HANDLE, 1001));
+
+	fifo.complete(accel.id, 1010, 1010);
+	ASSERT_EQ(1u, completed.size());
+	EXPECT_EQ(GAME_ROT_HANDLE, completed[0].handle);
+}
+
+TEST_F(FlushCoalescerTest, ReissueFailureCompletesPending)
+{
+	EXPECT_EQ(1, fifo.request(accel.id, ACCEL_HANDLE, 1000));
+	EXPECT_EQ(0, fifo.request(accel.id, GAME_ROT_HANDLE, 1001));
+
+	accel.hw_flush_err = -EIO;
+	fifo.complete(accel.id, 1010, 1010);
+
+	ASSERT_EQ(2u, completed.size());
+	EXPECT_EQ(GAME_ROT_HANDLE, completed[1].handle);
+	EXPECT_EQ(1010, completed[1].timestamp);
+}
+
+TEST_F(FlushCoalescerTest, InvalidDevice)
+{
+	EXPECT_EQ(-EINVAL, fifo.request(2, ACCEL_HANDLE, 1000));
+}
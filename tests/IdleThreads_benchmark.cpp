@@ -0,0 +1,375 @@
+/*
+ * STMicroelectronics idle sensor threads footprint benchmark
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#define __STDC_LIMIT_MACROS
+#define __STDINT_LIMITS
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "SensorBase.h"
+#include "SWSensorBase.h"
+
+/* HW_SENSOR_BASE_DEFAULT_IIO_BUFFER_LEN */
+#define IIO_BUFFER_LEN		(2)
+
+#define NUM_STEPS		(4)
+
+/*
+ * HWSensorBase needs an iio device: HW sensors are SensorBase with the
+ * data/events tasks of HWSensorBase (same buffers, same poll() loop on a
+ * never readable fd). Threads lifecycle, Enable() and the virtual sensors
+ * (SWSensorBaseWithPollrate) are the HAL ones.
+ */
+class IdleHWSensor : public SensorBase {
+private:
+	bool data_channels, event_channels;
+	unsigned int scan_size;
+	int iio_fd[2];
+
+public:
+	IdleHWSensor(const char *name, int handle, int type,
+		     unsigned int hw_fifo_len, bool data, bool events) :
+		     SensorBase(name, handle, type)
+	{
+		data_channels = data;
+		event_channels = events;
+		scan_size = 16;
+		sensor_t_data.fifoMaxEventCount = hw_fifo_len;
+		android_tap.setMaxBatchLength(hw_fifo_len);
+
+		if (pipe(iio_fd) < 0)
+			InvalidThisClass();
+	}
+
+	virtual ~IdleHWSensor()
+	{
+		close(iio_fd[0]);
+		close(iio_fd[1]);
+	}
+
+	bool hasDataChannels() { return data_channels; }
+	bool hasEventChannels() { return event_channels; }
+
+	void ThreadDataTask()
+	{
+		int err;
+		uint8_t *data;
+		unsigned int hw_fifo_len;
+		struct pollfd pollfd_data[2];
+
+		hw_fifo_len = sensor_t_data.fifoMaxEventCount > 0 ?
+					sensor_t_data.fifoMaxEventCount : 1;
+
+		data = (uint8_t *)malloc(hw_fifo_len * scan_size * IIO_BUFFER_LEN);
+		if (!data)
+			return;
+
+		pollfd_data[0].fd = iio_fd[0];
+		pollfd_data[0].events = POLLIN;
+		GetThreadStopPollfd(&pollfd_data[1]);
+
+		while (true) {
+			err = poll(pollfd_data, 2, SENSOR_BASE_THREAD_POLL_TIMEOUT);
+			if (err <= 0) {
+				if ((err == 0) && ThreadIdleExpired(false))
+					break;
+
+				continue;
+			}
+
+			if (pollfd_data[1].revents & POLLIN)
+				break;
+		}
+
+		free(data);
+	}
+
+	void ThreadEventsTask()
+	{
+		int err;
+		struct pollfd pollfd_events[2];
+
+		pollfd_events[0].fd = iio_fd[0];
+		pollfd_events[0].events = POLLIN;
+		GetThreadStopPollfd(&pollfd_events[1]);
+
+		while (true) {
+			err = poll(pollfd_events, 2, SENSOR_BASE_THREAD_POLL_TIMEOUT);
+			if (err <= 0) {
+				if ((err == 0) && ThreadIdleExpired(true))
+					break;
+
+				continue;
+			}
+
+			if (pollfd_events[1].revents & POLLIN)
+				break;
+		}
+	}
+};
+
+/*
+ * sensors of the modeled device (lsm6dsm + lis2mdl + lps22hb + hts221 and
+ * the virtual sensors computed by the HAL)
+ */
+struct hw_sensor {
+	const char *name;
+	int type;
+	unsigned int hw_fifo_len;
+	bool data;
+	bool events;
+};
+
+struct sw_sensor {
+	const char *name;
+	int type;
+	int dependencies[3];
+};
+
+enum {
+	ACCEL = 0,
+	GYRO,
+	MAGN,
+	PRESSURE,
+	TEMP,
+	HUMIDITY,
+	STEP_COUNTER,
+	STEP_DETECTOR,
+	SIGN_MOTION,
+	TILT,
+	WRIST_TILT,
+	NUM_HW_SENSORS,
+};
+
+enum {
+	ACCEL_UNCALIB = NUM_HW_SENSORS,
+	GYRO_UNCALIB,
+	MAGN_UNCALIB,
+	FUSION_6X,
+	FUSION_9X,
+	GAME_RV,
+	RV,
+	GEOMAG_RV,
+	GRAVITY,
+	LINEAR_ACCEL,
+	ORIENTATION,
+	NUM_SENSORS,
+};
+
+static const struct hw_sensor hw_sensors[NUM_HW_SENSORS] = {
+	{ "accel", SENSOR_TYPE_ACCELEROMETER, 682, true, false },
+	{ "gyro", SENSOR_TYPE_GYROSCOPE, 682, true, false },
+	{ "magn", SENSOR_TYPE_MAGNETIC_FIELD, 1, true, false },
+	{ "pressure", SENSOR_TYPE_PRESSURE, 1, true, false },
+	{ "temp", SENSOR_TYPE_AMBIENT_TEMPERATURE, 1, true, false },
+	{ "humidity", SENSOR_TYPE_RELATIVE_HUMIDITY, 1, true, false },
+	{ "step_counter", SENSOR_TYPE_STEP_COUNTER, 1, true, true },
+	{ "step_detector", SENSOR_TYPE_STEP_DETECTOR, 1, false, true },
+	{ "sign_motion", SENSOR_TYPE_SIGNIFICANT_MOTION, 1, false, true },
+	{ "tilt", SENSOR_TYPE_TILT_DETECTOR, 1, false, true },
+	{ "wrist_tilt", SENSOR_TYPE_WRIST_TILT_GESTURE, 1, false, true },
+};
+
+static const struct sw_sensor sw_sensors[NUM_SENSORS - NUM_HW_SENSORS] = {
+	{ "accel_uncalib", SENSOR_TYPE_ACCELEROMETER_UNCALIBRATED, { ACCEL, -1, -1 } },
+	{ "gyro_uncalib", SENSOR_TYPE_GYROSCOPE_UNCALIBRATED, { GYRO, -1, -1 } },
+	{ "magn_uncalib", SENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED, { MAGN, -1, -1 } },
+	{ "fusion6X", SENSOR_TYPE_DEVICE_PRIVATE_BASE, { ACCEL, GYRO, -1 } },
+	{ "fusion9X", SENSOR_TYPE_DEVICE_PRIVATE_BASE + 1, { ACCEL, GYRO, MAGN } },
+	{ "game_rv", SENSOR_TYPE_GAME_ROTATION_VECTOR, { FUSION_6X, -1, -1 } },
+	{ "rv", SENSOR_TYPE_ROTATION_VECTOR, { FUSION_9X, -1, -1 } },
+	{ "geomag_rv", SENSOR_TYPE_GEOMAGNETIC_ROTATION_VECTOR, { ACCEL, MAGN, -1 } },
+	{ "gravity", SENSOR_TYPE_GRAVITY, { FUSION_6X, -1, -1 } },
+	{ "linear_accel", SENSOR_TYPE_LINEAR_ACCELERATION, { FUSION_6X, -1, -1 } },
+	{ "orientation", SENSOR_TYPE_ORIENTATION, { FUSION_9X, -1, -1 } },
+};
+
+static const char *step_label[NUM_STEPS] = {
+	"open, all sensors idle",
+	"game_rv enabled",
+	"game_rv disabled",
+	"game_rv disabled, idle timeout expired",
+};
+
+struct footprint {
+	long rss;
+	long threads;
+};
+
+static void read_footprint(struct footprint *fp)
+{
+	FILE *f;
+	char line[128];
+
+	/* let new threads reach poll() */
+	usleep(100000);
+
+	fp->rss = fp->threads = -1;
+
+	f = fopen("/proc/self/status", "r");
+	if (!f)
+		return;
+
+	while (fgets(line, sizeof(line), f)) {
+		sscanf(line, "VmRSS: %ld", &fp->rss);
+		sscanf(line, "Threads: %ld", &fp->threads);
+	}
+
+	fclose(f);
+}
+
+static int open_sensors(SensorBase **sensors)
+{
+	int i, n, handle = 1;
+
+	for (i = 0; i < NUM_HW_SENSORS; i++) {
+		sensors[i] = new IdleHWSensor(hw_sensors[i].name, handle++,
+					      hw_sensors[i].type,
+					      hw_sensors[i].hw_fifo_len,
+					      hw_sensors[i].data,
+					      hw_sensors[i].events);
+		if (!sensors[i]->IsValidClass())
+			return -EINVAL;
+	}
+
+	for (i = NUM_HW_SENSORS; i < NUM_SENSORS; i++) {
+		const struct sw_sensor *sw = &sw_sensors[i - NUM_HW_SENSORS];
+
+		sensors[i] = new SWSensorBaseWithPollrate(sw->name, handle++,
+							  sw->type, true, true,
+							  true, false);
+		if (!sensors[i]->IsValidClass())
+			return -EINVAL;
+
+		for (n = 0; (n < 3) && (sw->dependencies[n] >= 0); n++) {
+			if (sensors[i]->AddSensorDependency(sensors[sw->dependencies[n]]) < 0)
+				return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * run_hal() - Open the sensors, switch game rotation vector on and off
+ * @eager: start every thread at open as the HAL does without lazy threads.
+ * @fp: footprint of every step.
+ *
+ * Runs in a child process: both runs start from the same footprint.
+ **/
+static int run_hal(bool eager, struct footprint *fp)
+{
+	int i, err;
+	SensorBase *sensors[NUM_SENSORS];
+	SensorBase *game_rv;
+
+	memset(sensors, 0, sizeof(sensors));
+
+	err = open_sensors(sensors);
+	if (err < 0)
+		return err;
+
+	game_rv = sensors[GAME_RV];
+
+	if (eager) {
+		for (i = 0; i < NUM_SENSORS; i++) {
+			err = sensors[i]->StartThreads();
+			if (err < 0)
+				return err;
+		}
+	}
+	read_footprint(&fp[0]);
+
+	err = game_rv->Enable(game_rv->GetHandle(), true, true);
+	if (err < 0)
+		return err;
+	read_footprint(&fp[1]);
+
+	err = game_rv->Enable(game_rv->GetHandle(), false, true);
+	if (err < 0)
+		return err;
+
+	/* power-off released the threads: eager ones are never released */
+	if (eager) {
+		for (i = 0; i < NUM_SENSORS; i++)
+			sensors[i]->StartThreads();
+	}
+	read_footprint(&fp[2]);
+
+	/* threads see the timeout at their next poll() timeout */
+	usleep(2 * CONFIG_ST_HAL_THREAD_IDLE_TIMEOUT * 1000000);
+	read_footprint(&fp[3]);
+
+	for (i = 0; i < NUM_SENSORS; i++)
+		sensors[i]->StopThreads();
+
+	for (i = NUM_SENSORS - 1; i >= 0; i--)
+		delete sensors[i];
+
+	return 0;
+}
+
+static int run_child(bool eager, struct footprint *fp)
+{
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		return -errno;
+
+	if (pid == 0)
+		_exit(run_hal(eager, fp) < 0 ? 1 : 0);
+
+	if ((waitpid(pid, &status, 0) < 0) || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		return -EIO;
+
+	return 0;
+}
+
+int main()
+{
+	int i;
+	struct footprint *eager, *lazy;
+
+	eager = (struct footprint *)mmap(NULL, 2 * NUM_STEPS * sizeof(struct footprint),
+					 PROT_READ | PROT_WRITE,
+					 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (eager == MAP_FAILED)
+		return 1;
+
+	lazy = eager + NUM_STEPS;
+
+	if (run_child(true, eager) < 0 || run_child(false, lazy) < 0) {
+		fprintf(stderr, "failed to run sensors\n");
+		return 1;
+	}
+
+	printf("%-40s %17s %17s\n", "", "eager", "lazy");
+	printf("%-40s %8s %8s %8s %8s\n", "state",
+	       "RSS[kB]", "threads", "RSS[kB]", "threads");
+
+	for (i = 0; i < NUM_STEPS; i++) {
+		printf("%-40s %8ld %8ld %8ld %8ld\n", step_label[i],
+		       eager[i].rss, eager[i].threads,
+		       lazy[i].rss, lazy[i].threads);
+	}
+
+	munmap(eager, 2 * NUM_STEPS * sizeof(struct footprint));
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * STMicroelectronics scan channels selection benchmark
+ *
+ * Copyright 2015-2016 STMicroelectronics Inc.
+ * Author: Denis Ciocca - <denis.ciocca@st.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+
+#define MAX_SCAN_ELEMENTS	(4)
+
+/*
+ * scan elements of lsm6dsx-style iio devices, channels are listed in
+ * scan index order with their scan element type
+ */
+struct scan_element {
+	const char *name;
+	const char *type;
+};
+
+struct scan_device {
+	const char *name;
+	/* data channels read by the sensor class, see ST_sensors_data_channels */
+	int data_channels;
+	struct scan_element elements[MAX_SCAN_ELEMENTS];
+};
+
+static const struct scan_device scan_devices[] = {
+	{ "lsm6dsx_accel", 3, {
+		{ "in_accel_x", "le:s16/16>>0" },
+		{ "in_accel_y", "le:s16/16>>0" },
+		{ "in_accel_z", "le:s16/16>>0" },
+		{ "in_timestamp", "le:s64/64>>0" } } },
+	{ "lsm6dsx_gyro", 3, {
+		{ "in_anglvel_x", "le:s16/16>>0" },
+		{ "in_anglvel_y", "le:s16/16>>0" },
+		{ "in_anglvel_z", "le:s16/16>>0" },
+		{ "in_timestamp", "le:s64/64>>0" } } },
+	{ "lis2mdl_magn", 3, {
+		{ "in_magn_x", "le:s16/16>>0" },
+		{ "in_magn_y", "le:s16/16>>0" },
+		{ "in_magn_z", "le:s16/16>>0" },
+		{ "in_timestamp", "le:s64/64>>0" } } },
+	{ "lps22hb_press", 1, {
+		{ "in_pressure", "le:u24/32>>0" },
+		{ "in_temp", "le:s16/16>>0" },
+		{ "in_timestamp", "le:s64/64>>0" } } },
+	{ "hts221", 1, {
+		{ "in_humidityrelative", "le:s16/16>>0" },
+		{ "in_temp", "le:s16/16>>0" },
+		{ "in_timestamp", "le:s64/64>>0" } } },
+};
+
+static int write_attr(const char *dir, const char *name, const char *attr,
+		      const char *value)
+{
+	FILE *f;
+	char filename[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+
+	snprintf(filename, sizeof(filename), "%s/%s%s", dir, name, attr);
+
+	f = fopen(filename, "w");
+	if (!f)
+		return -errno;
+
+	fprintf(f, "%s\n", value);
+	fclose(f);
+
+	return 0;
+}
+
+/*
+ * make_device() - Build device scan_elements in a sysfs like directory
+ * @root: directory holding the fake devices.
+ * @dev: device to build.
+ * @device_dir: device path.
+ **/
+static int make_device(const char *root, const struct scan_device *dev,
+		       char *device_dir)
+{
+	int i, err;
+	char dir[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+	char index[16];
+
+	snprintf(device_dir, DEVICE_IIO_MAX_FILENAME_LEN, "%s/%s", root, dev->name);
+	if (snprintf(dir, sizeof(dir), "%s/scan_elements", device_dir) >= (int)sizeof(dir))
+		return -ENOMEM;
+
+	if (mkdir(device_dir, 0755) < 0 || mkdir(dir, 0755) < 0)
+		return -errno;
+
+	for (i = 0; (i < MAX_SCAN_ELEMENTS) && dev->elements[i].name; i++) {
+		snprintf(index, sizeof(index), "%d", i);
+
+		err = write_attr(dir, dev->elements[i].name, "_en", "0");
+		if (!err)
+			err = write_attr(dir, dev->elements[i].name, "_index", index);
+		if (!err)
+			err = write_attr(dir, dev->elements[i].name, "_type",
+					 dev->elements[i].type);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	int err, n, num_channels, size_all, channels_all;
+	char root[] = "/tmp/st_scan_XXXXXX";
+	char device_dir[DEVICE_IIO_MAX_FILENAME_LEN + 1];
+	char cmd[DEVICE_IIO_MAX_FILENAME_LEN + 16];
+	struct device_iio_info_channel *channels;
+
+	if (!mkdtemp(root)) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	printf("%-16s %17s %17s\n", "", "all channels", "selected");
+	printf("%-16s %8s %8s %8s %8s\n", "device",
+	       "channels", "bytes", "channels", "bytes");
+
+	for (n = 0; n < (int)(sizeof(scan_devices) / sizeof(scan_devices[0])); n++) {
+		err = make_device(root, &scan_devices[n], device_dir);
+		if (err < 0)
+			break;
+
+		channels = NULL;
+		err = device_iio_utils::scan_channel(device_dir, &channels,
+						     &num_channels);
+		if (err < 0)
+			break;
+
+		channels_all = num_channels;
+		size_all = device_iio_utils::get_scan_size(channels, num_channels);
+
+		err = device_iio_utils::select_channels(device_dir, channels,
+							&num_channels,
+							scan_devices[n].data_channels,
+							false);
+		if (err < 0)
+			break;
+
+		/* timestamp must survive the selection */
+		if (!num_channels ||
+		    !device_iio_utils::is_timestamp_channel(&channels[num_channels - 1])) {
+			err = -EINVAL;
+			break;
+		}
+
+		printf("%-16s %8d %8d %8d %8d\n", scan_devices[n].name,
+		       channels_all, size_all, num_channels,
+		       device_iio_utils::get_scan_size(channels, num_channels));
+
+		while (num_channels--)
+			free(channels[num_channels].name);
+		free(channels);
+	}
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	if (system(cmd) < 0)
+		perror("system");
+
+	if (err < 0) {
+		fprintf(stderr, "failed to select scan channels (%d)\n", err);
+		return 1;
+	}
+
+	return 0;
+}